@@ -0,0 +1,67 @@
+#include "AsyncCompute.h"
+#include <stdexcept>
+
+void LibGFX::AsyncCompute::create(VkContext& context, uint32_t framesInFlight)
+{
+	if (framesInFlight == 0) {
+		throw std::runtime_error("AsyncCompute: at least one frame in flight is required");
+	}
+
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	m_dedicated = indices.hasDedicatedCompute();
+	m_frames.resize(framesInFlight);
+	for (Frame& frame : m_frames) {
+		frame.commandPool = context.createCommandPool(static_cast<uint32_t>(indices.computeFamily), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		frame.commandBuffer = context.allocateCommandBuffer(frame.commandPool);
+		frame.fence = context.createFence(VK_FENCE_CREATE_SIGNALED_BIT);
+		frame.finishedSemaphore = context.createSemaphore();
+	}
+	m_currentFrame = 0;
+}
+
+void LibGFX::AsyncCompute::destroy(VkContext& context)
+{
+	for (Frame& frame : m_frames) {
+		context.waitForFence(frame.fence);
+		context.destroySemaphore(frame.finishedSemaphore);
+		context.destroyFence(frame.fence);
+		// Destroying the pool frees its command buffer
+		context.destroyCommandPool(frame.commandPool);
+	}
+	m_frames.clear();
+}
+
+VkCommandBuffer LibGFX::AsyncCompute::begin(VkContext& context, uint32_t frameIndex)
+{
+	m_currentFrame = frameIndex % static_cast<uint32_t>(m_frames.size());
+	Frame& frame = m_frames[m_currentFrame];
+
+	context.waitForFence(frame.fence);
+	context.resetFence(frame.fence);
+
+	if (vkResetCommandPool(context.getDevice(), frame.commandPool, 0) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to reset compute command pool");
+	}
+	context.beginCommandBuffer(frame.commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	return frame.commandBuffer;
+}
+
+VkSemaphore LibGFX::AsyncCompute::submit(VkContext& context, VkSemaphore waitSemaphore /*= VK_NULL_HANDLE*/, VkPipelineStageFlags waitStage /*= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT*/)
+{
+	Frame& frame = m_frames[m_currentFrame];
+	context.endCommandBuffer(frame.commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
+	if (waitSemaphore != VK_NULL_HANDLE) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &frame.finishedSemaphore;
+	context.submitCommandBuffer(context.getComputeQueue(), submitInfo, frame.fence);
+	return frame.finishedSemaphore;
+}
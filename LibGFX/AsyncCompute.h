@@ -0,0 +1,43 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Per frame command buffers for the compute queue. Work submitted here (culling, skinning, particles)
+	// overlaps the graphics work of the previous frame, the graphics submission that consumes the results
+	// waits on the returned semaphore, e.g. through FrameRing::addWaitSemaphore.
+	// Buffers written here and read by graphics need recordComputeBufferRelease / recordComputeBufferAcquire.
+	// Nothing orders the writes against graphics still reading the previous results, so keep one output per
+	// frame in flight and call begin after FrameRing::beginFrame of the same frame: its fence wait covers the reads.
+	// Outputs that keep their contents also need recordGraphicsBufferRelease after the last graphics read and
+	// recordGraphicsBufferAcquire here. Pass waitSemaphore to submit for work that consumes graphics results.
+	// Without a dedicated compute family the submissions go to the graphics queue and stay correct.
+	class AsyncCompute
+	{
+	public:
+		void create(VkContext& context, uint32_t framesInFlight);
+		void destroy(VkContext& context);
+
+		// Waits until the frame's previous compute submission is done, which is normally already the case
+		VkCommandBuffer begin(VkContext& context, uint32_t frameIndex);
+		// Every returned semaphore must be waited on by exactly one submission before the frame comes around again
+		VkSemaphore submit(VkContext& context, VkSemaphore waitSemaphore = VK_NULL_HANDLE, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		VkCommandBuffer getCommandBuffer() const { return m_frames[m_currentFrame].commandBuffer; }
+		VkSemaphore getSemaphore() const { return m_frames[m_currentFrame].finishedSemaphore; }
+		bool isDedicated() const { return m_dedicated; }
+	private:
+		struct Frame {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore finishedSemaphore = VK_NULL_HANDLE;
+		};
+
+		std::vector<Frame> m_frames;
+		uint32_t m_currentFrame = 0;
+		bool m_dedicated = false;
+	};
+}
@@ -0,0 +1,148 @@
+#include "BindlessTable.h"
+#include "DescriptorSetLayoutBuilder.h"
+#include "DescriptorPoolBuilder.h"
+#include <algorithm>
+#include <stdexcept>
+
+void LibGFX::BindlessTable::create(VkContext& context, uint32_t framesInFlight, uint32_t maxImages /*= 16384*/, uint32_t maxBuffers /*= 4096*/)
+{
+	if (!context.supportsBindless()) {
+		throw std::runtime_error("Failed to create bindless table: descriptor indexing is not enabled");
+	}
+
+	// Combined image samplers count against the sampler and the sampled image limits
+	const VkPhysicalDeviceDescriptorIndexingProperties& limits = context.getDescriptorIndexingProperties();
+	maxImages = std::min({ maxImages,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+	maxBuffers = std::min({ maxBuffers,
+		limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+	// Both bindings are visible to every stage, so together they must fit the per stage resource limit
+	uint64_t totalCount = static_cast<uint64_t>(maxImages) + maxBuffers;
+	uint64_t maxResources = limits.maxPerStageUpdateAfterBindResources;
+	if (totalCount > maxResources) {
+		maxImages = static_cast<uint32_t>(maxImages * maxResources / totalCount);
+		maxBuffers = static_cast<uint32_t>(maxBuffers * maxResources / totalCount);
+	}
+
+	VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	DescriptorSetLayoutBuilder layoutBuilder;
+	layoutBuilder.addBinding(IMAGE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL, maxImages)
+		.addBinding(BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, maxBuffers)
+		.setBindingFlags(IMAGE_BINDING, bindingFlags)
+		.setBindingFlags(BUFFER_BINDING, bindingFlags);
+	m_layout = layoutBuilder.build(context);
+
+	DescriptorPoolBuilder poolBuilder;
+	m_pool = poolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxImages)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers)
+		.setMaxSets(1)
+		.setFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+		.build(context);
+	m_descriptorSet = context.allocateDescriptorSet(m_pool, m_layout);
+
+	m_images = SlotAllocator();
+	m_images.capacity = maxImages;
+	m_buffers = SlotAllocator();
+	m_buffers.capacity = maxBuffers;
+	m_framesInFlight = std::max(framesInFlight, 1u);
+	m_frame = 0;
+	m_writer.clear();
+}
+
+void LibGFX::BindlessTable::destroy(VkContext& context)
+{
+	m_writer.clear();
+	if (m_pool != VK_NULL_HANDLE) {
+		context.destroyDescriptorSetPool(m_pool);
+		m_descriptorSet = VK_NULL_HANDLE;
+	}
+	if (m_layout != VK_NULL_HANDLE) {
+		context.destroyDescriptorSetLayout(m_layout);
+		m_layout = VK_NULL_HANDLE;
+	}
+	m_images = SlotAllocator();
+	m_buffers = SlotAllocator();
+}
+
+LibGFX::BindlessIndex LibGFX::BindlessTable::addImage(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout /*= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL*/)
+{
+	BindlessIndex index = m_images.allocate();
+	m_writer.addImageInfo(imageView, sampler, imageLayout)
+		.queue(m_descriptorSet, IMAGE_BINDING, index, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	return index;
+}
+
+LibGFX::BindlessIndex LibGFX::BindlessTable::addImage(const Image& image, VkSampler sampler)
+{
+	return addImage(image.imageView, sampler);
+}
+
+LibGFX::BindlessIndex LibGFX::BindlessTable::addBuffer(const Buffer& buffer, VkDeviceSize range /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/)
+{
+	BindlessIndex index = m_buffers.allocate();
+	m_writer.addBufferInfo(buffer.buffer, offset, range)
+		.queue(m_descriptorSet, BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	return index;
+}
+
+void LibGFX::BindlessTable::removeImage(BindlessIndex index)
+{
+	m_images.retire(index, m_frame);
+}
+
+void LibGFX::BindlessTable::removeBuffer(BindlessIndex index)
+{
+	m_buffers.retire(index, m_frame);
+}
+
+void LibGFX::BindlessTable::beginFrame()
+{
+	m_frame++;
+	m_images.recycle(m_frame, m_framesInFlight);
+	m_buffers.recycle(m_frame, m_framesInFlight);
+}
+
+void LibGFX::BindlessTable::flush(VkContext& context)
+{
+	// Infos outlive flush in the writer, the table never reuses them
+	m_writer.flush(context);
+	m_writer.clear();
+}
+
+void LibGFX::BindlessTable::bind(VkContext& context, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set)
+{
+	flush(context);
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &m_descriptorSet, 0, nullptr);
+}
+
+LibGFX::BindlessIndex LibGFX::BindlessTable::SlotAllocator::allocate()
+{
+	if (!freeSlots.empty()) {
+		BindlessIndex index = freeSlots.back();
+		freeSlots.pop_back();
+		return index;
+	}
+	if (next >= capacity) {
+		throw std::runtime_error("BindlessTable: no free slot left");
+	}
+	return next++;
+}
+
+void LibGFX::BindlessTable::SlotAllocator::retire(BindlessIndex index, uint64_t frame)
+{
+	if (index >= next) {
+		throw std::runtime_error("BindlessTable: index was never allocated");
+	}
+	retiredSlots.emplace_back(frame, index);
+}
+
+void LibGFX::BindlessTable::SlotAllocator::recycle(uint64_t frame, uint32_t framesInFlight)
+{
+	// Command buffers recorded up to the frame of removal may still read the slot until they are all done
+	while (!retiredSlots.empty() && retiredSlots.front().first + framesInFlight <= frame) {
+		freeSlots.push_back(retiredSlots.front().second);
+		retiredSlots.pop_front();
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <limits>
+#include "VkContext.h"
+#include "DescriptorSetWriter.h"
+
+namespace LibGFX {
+
+	// Slot of a resource in a BindlessTable, passed to shaders e.g. through push constants or instance data
+	using BindlessIndex = uint32_t;
+
+	// One descriptor set with large update after bind, partially bound arrays of combined image samplers
+	// (binding 0) and storage buffers (binding 1). Shaders index them directly:
+	//   layout(set = S, binding = 0) uniform sampler2D textures[];
+	//   layout(set = S, binding = 1) buffer Buffers { ... } buffers[];
+	// so the set is bound once per command buffer instead of once per draw. Needs VkContext::requestBindless.
+	// Slots in use by frames in flight are never rewritten: removed slots are recycled framesInFlight frames later,
+	// and a resource that changes (e.g. a streamed texture) gets a new index while the old one is removed.
+	class BindlessTable
+	{
+	public:
+		static constexpr uint32_t IMAGE_BINDING = 0;
+		static constexpr uint32_t BUFFER_BINDING = 1;
+		static constexpr BindlessIndex INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		// Counts are clamped to the update after bind limits of the device
+		void create(VkContext& context, uint32_t framesInFlight, uint32_t maxImages = 16384, uint32_t maxBuffers = 4096);
+		void destroy(VkContext& context);
+
+		BindlessIndex addImage(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		BindlessIndex addImage(const Image& image, VkSampler sampler);
+		BindlessIndex addBuffer(const Buffer& buffer, VkDeviceSize range = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		void removeImage(BindlessIndex index);
+		void removeBuffer(BindlessIndex index);
+
+		// Once per frame after waiting for the frame's fence, recycles the slots removed framesInFlight frames ago
+		void beginFrame();
+		// Writes the added slots, bind does this as well. Update after bind allows it after the set was bound.
+		void flush(VkContext& context);
+		void bind(VkContext& context, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set);
+
+		VkDescriptorSetLayout getLayout() const { return m_layout; }
+		VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+		uint32_t getImageCapacity() const { return m_images.capacity; }
+		uint32_t getBufferCapacity() const { return m_buffers.capacity; }
+		uint32_t getImageCount() const { return m_images.getUsedCount(); }
+		uint32_t getBufferCount() const { return m_buffers.getUsedCount(); }
+	private:
+		// Hands out the lowest unused slots first and holds removed ones until no frame in flight can read them
+		struct SlotAllocator {
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<uint32_t> freeSlots;
+			std::deque<std::pair<uint64_t, uint32_t>> retiredSlots;	// Frame of removal, slot
+
+			BindlessIndex allocate();
+			void retire(BindlessIndex index, uint64_t frame);
+			void recycle(uint64_t frame, uint32_t framesInFlight);
+			uint32_t getUsedCount() const { return next - static_cast<uint32_t>(freeSlots.size() + retiredSlots.size()); }
+		};
+
+		VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_pool = VK_NULL_HANDLE;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+		DescriptorSetWriter m_writer;
+		SlotAllocator m_images;
+		SlotAllocator m_buffers;
+		uint32_t m_framesInFlight = 1;
+		uint64_t m_frame = 0;
+	};
+}
@@ -1,10 +1,13 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include "MemoryAllocation.h"
 
 namespace LibGFX {
 	struct Buffer {
 		VkBuffer buffer;
 		VkDeviceMemory memory;
 		VkDeviceSize size;
+		MemoryAllocation allocation;
+		void* mapped; // Persistently mapped pointer for host visible buffers, nullptr otherwise
 	};
 }
\ No newline at end of file
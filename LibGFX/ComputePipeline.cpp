@@ -0,0 +1,80 @@
+#include "ComputePipeline.h"
+#include "VkContext.h"
+#include <stdexcept>
+
+LibGFX::ComputePipeline& LibGFX::ComputePipeline::setShader(const std::vector<char>& code, const std::string& entryPoint /*= "main"*/)
+{
+	m_shaderCode = code;
+	m_entryPoint = entryPoint;
+	return *this;
+}
+
+LibGFX::ComputePipeline& LibGFX::ComputePipeline::addDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout)
+{
+	m_descriptorSetLayouts.push_back(descriptorSetLayout);
+	return *this;
+}
+
+LibGFX::ComputePipeline& LibGFX::ComputePipeline::addPushConstantRange(uint32_t size, uint32_t offset /*= 0*/)
+{
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	range.offset = offset;
+	range.size = size;
+	m_pushConstantRanges.push_back(range);
+	return *this;
+}
+
+LibGFX::ComputePipeline& LibGFX::ComputePipeline::setSpecialization(const VkSpecializationInfo* specializationInfo)
+{
+	m_specializationInfo = specializationInfo;
+	return *this;
+}
+
+void LibGFX::ComputePipeline::create(VkContext& context)
+{
+	if (m_shaderCode.empty()) {
+		throw std::runtime_error("ComputePipeline: no shader set");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = static_cast<uint32_t>(m_descriptorSetLayouts.size());
+	layoutInfo.pSetLayouts = m_descriptorSetLayouts.data();
+	layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(m_pushConstantRanges.size());
+	layoutInfo.pPushConstantRanges = m_pushConstantRanges.data();
+
+	if (vkCreatePipelineLayout(context.getDevice(), &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline layout");
+	}
+
+	VkShaderModule shaderModule = context.createShaderModule(m_shaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = m_entryPoint.c_str();
+	pipelineInfo.stage.pSpecializationInfo = m_specializationInfo;
+	pipelineInfo.layout = m_pipelineLayout;
+
+	// The module is not needed once the pipeline exists
+	try {
+		m_pipeline = context.createComputePipeline(pipelineInfo);
+	}
+	catch (...) {
+		context.destroyShaderModule(shaderModule);
+		throw;
+	}
+	context.destroyShaderModule(shaderModule);
+}
+
+void LibGFX::ComputePipeline::destroy(VkContext& context)
+{
+	context.destroyPipeline(m_pipeline);
+	if (m_pipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(context.getDevice(), m_pipelineLayout, nullptr);
+		m_pipelineLayout = VK_NULL_HANDLE;
+	}
+}
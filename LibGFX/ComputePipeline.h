@@ -0,0 +1,37 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include "Pipeline.h"
+
+namespace LibGFX {
+
+	// Compute pipeline with its own layout, configured before create.
+	// Bind with VkContext::bindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline).
+	class ComputePipeline : public Pipeline
+	{
+	public:
+		ComputePipeline& setShader(const std::vector<char>& code, const std::string& entryPoint = "main");
+		ComputePipeline& addDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
+		ComputePipeline& addPushConstantRange(uint32_t size, uint32_t offset = 0);
+		// The info and its data must stay valid until create, e.g. for the local size via constant_id
+		ComputePipeline& setSpecialization(const VkSpecializationInfo* specializationInfo);
+
+		void create(VkContext& context) override;
+		void destroy(VkContext& context) override;
+		VkPipeline getPipeline() const override { return m_pipeline; }
+		VkPipelineLayout getPipelineLayout() const override { return m_pipelineLayout; }
+
+		// Number of work groups covering count invocations
+		static uint32_t getGroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+	private:
+		std::vector<char> m_shaderCode;
+		std::string m_entryPoint = "main";
+		std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
+		std::vector<VkPushConstantRange> m_pushConstantRanges;
+		const VkSpecializationInfo* m_specializationInfo = nullptr;
+
+		VkPipeline m_pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	};
+}
@@ -2,6 +2,11 @@
 #include <array>
 #include <stdexcept>
 
+LibGFX::Presets::DefaultRenderPass::DefaultRenderPass(VkImageLayout colorFinalLayout /*= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR*/)
+{
+	m_colorFinalLayout = colorFinalLayout;
+}
+
 VkRenderPass LibGFX::Presets::DefaultRenderPass::getRenderPass() const
 {
 	return m_renderPass;
@@ -18,7 +23,7 @@ bool LibGFX::Presets::DefaultRenderPass::create(VkContext& context, VkFormat swa
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = m_colorFinalLayout;
 
 	// Color attachment reference
 	VkAttachmentReference colorAttachmentRef = {};
@@ -62,7 +67,7 @@ bool LibGFX::Presets::DefaultRenderPass::create(VkContext& context, VkFormat swa
 	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = 0;
 
-	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to the final layout
 	dependencies[1].srcSubpass = 0;
 	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -72,6 +77,16 @@ bool LibGFX::Presets::DefaultRenderPass::create(VkContext& context, VkFormat swa
 	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[1].dependencyFlags = 0;
 
+	// Offscreen results are read by a copy or a shader afterwards
+	if (m_colorFinalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	else if (m_colorFinalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
+
 	// Render pass create info
 	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 	VkRenderPassCreateInfo renderPassInfo = {};
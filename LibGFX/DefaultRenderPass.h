@@ -9,8 +9,11 @@ namespace LibGFX {
 		class DefaultRenderPass : public LibGFX::RenderPass
 		{
 		private:
-			VkRenderPass m_renderPass;
+			VkRenderPass m_renderPass = VK_NULL_HANDLE;
+			VkImageLayout m_colorFinalLayout;
 		public:
+			// Offscreen targets use TRANSFER_SRC_OPTIMAL or SHADER_READ_ONLY_OPTIMAL instead of the present layout
+			DefaultRenderPass(VkImageLayout colorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 			VkRenderPass getRenderPass() const override;
 			bool create(VkContext& context, VkFormat swapchainImageFormat, VkFormat depthFormat) override;
 			void destroy(VkContext& context) override;
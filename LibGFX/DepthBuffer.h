@@ -1,11 +1,20 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include "MemoryAllocation.h"
 
 namespace LibGFX {
+	// Depth bits of the depth buffer format, fewer bits cut bandwidth at the cost of precision
+	enum class DepthPrecision {
+		D16,
+		D32
+	};
+
 	struct DepthBuffer {
 		VkImage image;
 		VkDeviceMemory memory;
 		VkImageView imageView;
 		VkFormat format;
+		MemoryAllocation allocation;
+		bool transient = false; // Contents never stored, may live in lazily allocated memory
 	};
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "DescriptorAllocator.h"
+#include "DescriptorPoolBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void LibGFX::DescriptorAllocator::create(VkContext& context, uint32_t setsPerPool /*= DEFAULT_SETS_PER_POOL*/, const std::vector<DescriptorPoolRatio>& ratios /*= {}*/)
+{
+	m_setsPerPool = std::clamp(setsPerPool, 1u, MAX_SETS_PER_POOL);
+	m_ratios = ratios;
+
+	// Reasonable mix for material and per object sets if nothing is configured
+	if (m_ratios.empty()) {
+		m_ratios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f }
+		};
+	}
+
+	m_currentPool = createPool(context, m_setsPerPool);
+	m_allocatedSets = 0;
+}
+
+void LibGFX::DescriptorAllocator::destroy(VkContext& context)
+{
+	if (m_currentPool != VK_NULL_HANDLE) {
+		context.destroyDescriptorSetPool(m_currentPool);
+		m_currentPool = VK_NULL_HANDLE;
+	}
+	for (auto& pool : m_readyPools) {
+		context.destroyDescriptorSetPool(pool);
+	}
+	for (auto& pool : m_fullPools) {
+		context.destroyDescriptorSetPool(pool);
+	}
+	m_readyPools.clear();
+	m_fullPools.clear();
+	m_layoutSizes.clear();
+	m_observedDescriptors.clear();
+	m_observedSets = 0;
+	m_allocatedSets = 0;
+}
+
+void LibGFX::DescriptorAllocator::registerLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& descriptorCounts)
+{
+	m_layoutSizes[layout] = descriptorCounts;
+}
+
+VkDescriptorSet LibGFX::DescriptorAllocator::allocate(VkContext& context, VkDescriptorSetLayout layout)
+{
+	return allocate(context, std::vector<VkDescriptorSetLayout>{ layout }).front();
+}
+
+std::vector<VkDescriptorSet> LibGFX::DescriptorAllocator::allocate(VkContext& context, const std::vector<VkDescriptorSetLayout>& layouts)
+{
+	std::vector<VkDescriptorSet> sets(layouts.size());
+	if (layouts.empty()) {
+		return sets;
+	}
+
+	uint32_t count = static_cast<uint32_t>(layouts.size());
+	observe(layouts);
+
+	VkResult result = allocateFromPool(context, m_currentPool, layouts, sets);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		// Retire the exhausted pool and retry once in a fresh one
+		m_fullPools.push_back(m_currentPool);
+		m_currentPool = nextPool(context, count);
+		result = allocateFromPool(context, m_currentPool, layouts, sets);
+	}
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		// Recycled pools keep their old sizes and the ratios may not cover these layouts, size a pool from their own counts
+		m_fullPools.push_back(m_currentPool);
+		m_currentPool = createPool(context, count, layouts);
+		result = allocateFromPool(context, m_currentPool, layouts, sets);
+	}
+
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		throw std::runtime_error("Failed to allocate descriptor sets: the layout needs more descriptors than the pool ratios provide, register it with registerLayout");
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate descriptor sets");
+	}
+
+	m_allocatedSets += count;
+	return sets;
+}
+
+void LibGFX::DescriptorAllocator::reset(VkContext& context)
+{
+	// Sets of all pools are released in bulk, the pools stay around for reuse
+	if (m_currentPool != VK_NULL_HANDLE) {
+		vkResetDescriptorPool(context.getDevice(), m_currentPool, 0);
+	}
+	for (auto pool : m_readyPools) {
+		vkResetDescriptorPool(context.getDevice(), pool, 0);
+	}
+	for (auto pool : m_fullPools) {
+		vkResetDescriptorPool(context.getDevice(), pool, 0);
+		m_readyPools.push_back(pool);
+	}
+	m_fullPools.clear();
+	m_allocatedSets = 0;
+}
+
+VkDescriptorPool LibGFX::DescriptorAllocator::createPool(VkContext& context, uint32_t minSets, const std::vector<VkDescriptorSetLayout>& layouts /*= {}*/)
+{
+	uint32_t maxSets = std::max(m_setsPerPool, minSets);
+
+	// Per set ratio is the larger of the configured and the observed one
+	std::map<VkDescriptorType, float> ratios;
+	for (const auto& ratio : m_ratios) {
+		ratios[ratio.type] = ratio.ratio;
+	}
+	if (m_observedSets > 0) {
+		for (const auto& [type, count] : m_observedDescriptors) {
+			float observed = static_cast<float>(count) / static_cast<float>(m_observedSets);
+			ratios[type] = std::max(ratios[type], observed);
+		}
+	}
+
+	std::map<VkDescriptorType, uint32_t> counts;
+	for (const auto& [type, ratio] : ratios) {
+		counts[type] = static_cast<uint32_t>(std::ceil(ratio * static_cast<float>(maxSets)));
+	}
+
+	// The requested layouts must fit in any case
+	std::map<VkDescriptorType, uint32_t> layoutCounts;
+	for (auto layout : layouts) {
+		auto it = m_layoutSizes.find(layout);
+		if (it == m_layoutSizes.end()) {
+			continue;
+		}
+		for (const auto& size : it->second) {
+			layoutCounts[size.type] += size.descriptorCount;
+		}
+	}
+	for (const auto& [type, count] : layoutCounts) {
+		counts[type] = std::max(counts[type], count);
+	}
+
+	DescriptorPoolBuilder builder;
+	for (const auto& [type, count] : counts) {
+		if (count > 0) {
+			builder.addPoolSize(type, count);
+		}
+	}
+	builder.setMaxSets(maxSets);
+	return builder.build(context);
+}
+
+VkDescriptorPool LibGFX::DescriptorAllocator::nextPool(VkContext& context, uint32_t minSets)
+{
+	// Recycled pools were sized for earlier usage, only reuse them when the request fits the default size
+	if (!m_readyPools.empty() && minSets <= m_setsPerPool) {
+		VkDescriptorPool pool = m_readyPools.back();
+		m_readyPools.pop_back();
+		return pool;
+	}
+
+	// Each new pool is larger than the last so long running growth needs fewer pools
+	m_setsPerPool = std::min(m_setsPerPool + m_setsPerPool / 2, MAX_SETS_PER_POOL);
+	return createPool(context, minSets);
+}
+
+VkResult LibGFX::DescriptorAllocator::allocateFromPool(VkContext& context, VkDescriptorPool pool, const std::vector<VkDescriptorSetLayout>& layouts, std::vector<VkDescriptorSet>& sets)
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+	allocInfo.pSetLayouts = layouts.data();
+	return vkAllocateDescriptorSets(context.getDevice(), &allocInfo, sets.data());
+}
+
+void LibGFX::DescriptorAllocator::observe(const std::vector<VkDescriptorSetLayout>& layouts)
+{
+	for (auto layout : layouts) {
+		auto it = m_layoutSizes.find(layout);
+		if (it == m_layoutSizes.end()) {
+			continue;
+		}
+		for (const auto& size : it->second) {
+			m_observedDescriptors[size.type] += size.descriptorCount;
+		}
+		m_observedSets++;
+	}
+}
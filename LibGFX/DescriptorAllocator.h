@@ -0,0 +1,55 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Descriptors of a type to reserve per set in a new pool
+	struct DescriptorPoolRatio {
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	// Allocates descriptor sets from a growing list of pools. A new pool is created when the current one
+	// runs out or is fragmented, reset() recycles all pools at once (e.g. one allocator per frame in flight).
+	// Pool sizes follow the configured ratios and the per set usage of the registered layouts.
+	class DescriptorAllocator
+	{
+	public:
+		static constexpr uint32_t DEFAULT_SETS_PER_POOL = 64;
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		void create(VkContext& context, uint32_t setsPerPool = DEFAULT_SETS_PER_POOL, const std::vector<DescriptorPoolRatio>& ratios = {});
+		void destroy(VkContext& context);
+
+		// Descriptor counts of a layout, see DescriptorSetLayoutBuilder::getPoolSizes.
+		// Required for layouts that need more descriptors per set than the ratios provide, e.g. large sampler arrays.
+		void registerLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& descriptorCounts);
+
+		VkDescriptorSet allocate(VkContext& context, VkDescriptorSetLayout layout);
+		// All sets are allocated with a single vkAllocateDescriptorSets call
+		std::vector<VkDescriptorSet> allocate(VkContext& context, const std::vector<VkDescriptorSetLayout>& layouts);
+		void reset(VkContext& context);
+
+		size_t getPoolCount() const { return m_readyPools.size() + m_fullPools.size() + (m_currentPool != VK_NULL_HANDLE ? 1 : 0); }
+		uint32_t getAllocatedSetCount() const { return m_allocatedSets; }
+	private:
+		std::vector<DescriptorPoolRatio> m_ratios;
+		std::map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>> m_layoutSizes;
+		std::map<VkDescriptorType, uint64_t> m_observedDescriptors;
+		uint64_t m_observedSets = 0;
+
+		VkDescriptorPool m_currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> m_readyPools;
+		std::vector<VkDescriptorPool> m_fullPools;
+		uint32_t m_setsPerPool = DEFAULT_SETS_PER_POOL;
+		uint32_t m_allocatedSets = 0;
+
+		VkDescriptorPool createPool(VkContext& context, uint32_t minSets, const std::vector<VkDescriptorSetLayout>& layouts = {});
+		VkDescriptorPool nextPool(VkContext& context, uint32_t minSets);
+		VkResult allocateFromPool(VkContext& context, VkDescriptorPool pool, const std::vector<VkDescriptorSetLayout>& layouts, std::vector<VkDescriptorSet>& sets);
+		void observe(const std::vector<VkDescriptorSetLayout>& layouts);
+	};
+}
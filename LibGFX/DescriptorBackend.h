@@ -0,0 +1,12 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+namespace LibGFX {
+
+	// Where descriptors of a set layout live. Descriptor buffer layouts cannot be allocated from pools,
+	// so the backend is chosen per layout, VkContext::getPreferredDescriptorBackend reports the one selected at init.
+	enum class DescriptorBackend {
+		Pool,	// VkDescriptorPool sets, written with DescriptorSetWriter
+		Buffer	// VK_EXT_descriptor_buffer, written and bound with DescriptorBuffer
+	};
+}
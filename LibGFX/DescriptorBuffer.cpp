@@ -0,0 +1,177 @@
+#include "DescriptorBuffer.h"
+#include <stdexcept>
+
+void LibGFX::DescriptorBuffer::create(VkContext& context, VkDeviceSize frameSize, uint32_t framesInFlight /*= 1*/)
+{
+	if (!context.supportsDescriptorBuffer()) {
+		throw std::runtime_error("Failed to create descriptor buffer: VK_EXT_descriptor_buffer is not supported");
+	}
+
+	// Set offsets and the binding address must both honor descriptorBufferOffsetAlignment
+	const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties = context.getDescriptorBufferProperties();
+	m_alignment = properties.descriptorBufferOffsetAlignment;
+	m_frameSize = ((frameSize + m_alignment - 1) / m_alignment) * m_alignment;
+	m_framesInFlight = framesInFlight;
+
+	// One buffer holds resource and sampler descriptors, so combined image samplers need no second binding
+	m_usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	m_buffer = context.createBuffer(
+		m_frameSize * framesInFlight,
+		m_usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	m_address = context.getBufferDeviceAddress(m_buffer);
+
+	m_frameStart = 0;
+	m_head = 0;
+}
+
+void LibGFX::DescriptorBuffer::destroy(VkContext& context)
+{
+	if (m_buffer.buffer != VK_NULL_HANDLE) {
+		context.destroyBuffer(m_buffer);
+	}
+	m_address = 0;
+	m_frameSize = 0;
+	m_frameStart = 0;
+	m_head = 0;
+	m_layoutSizes.clear();
+}
+
+void LibGFX::DescriptorBuffer::beginFrame(uint32_t frameIndex)
+{
+	// The frame's previous descriptors are no longer read once its fence has signaled
+	m_frameStart = static_cast<VkDeviceSize>(frameIndex % m_framesInFlight) * m_frameSize;
+	m_head = m_frameStart;
+}
+
+LibGFX::DescriptorBufferSet LibGFX::DescriptorBuffer::allocate(VkContext& context, VkDescriptorSetLayout layout)
+{
+	auto it = m_layoutSizes.find(layout);
+	if (it == m_layoutSizes.end()) {
+		it = m_layoutSizes.emplace(layout, context.getDescriptorSetLayoutSize(layout)).first;
+	}
+
+	VkDeviceSize alignedSize = ((it->second + m_alignment - 1) / m_alignment) * m_alignment;
+	if (m_head + alignedSize > m_frameStart + m_frameSize) {
+		throw std::runtime_error("DescriptorBuffer: frame region exhausted");
+	}
+
+	DescriptorBufferSet set = {};
+	set.layout = layout;
+	set.offset = m_head;
+	set.size = it->second;
+
+	m_head += alignedSize;
+	return set;
+}
+
+void LibGFX::DescriptorBuffer::writeBuffer(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, VkDescriptorType type, const Buffer& buffer, VkDeviceSize range /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/, uint32_t arrayElement /*= 0*/)
+{
+	VkDescriptorAddressInfoEXT addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+	addressInfo.address = context.getBufferDeviceAddress(buffer) + offset;
+	addressInfo.range = range == VK_WHOLE_SIZE ? buffer.size - offset : range;
+	addressInfo.format = VK_FORMAT_UNDEFINED;
+
+	VkDescriptorGetInfoEXT getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+	getInfo.type = type;
+	switch (type) {
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		getInfo.data.pUniformBuffer = &addressInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		getInfo.data.pStorageBuffer = &addressInfo;
+		break;
+	default:
+		throw std::runtime_error("DescriptorBuffer: unsupported buffer descriptor type");
+	}
+
+	size_t descriptorSize = getDescriptorSize(context.getDescriptorBufferProperties(), type);
+	context.getDescriptor(getInfo, descriptorSize, getDescriptorAddress(context, set, binding, arrayElement, descriptorSize));
+}
+
+void LibGFX::DescriptorBuffer::writeImage(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout /*= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL*/, uint32_t arrayElement /*= 0*/)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = imageLayout;
+
+	VkDescriptorGetInfoEXT getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+	getInfo.type = type;
+	switch (type) {
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		getInfo.data.pCombinedImageSampler = &imageInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		getInfo.data.pSampledImage = &imageInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		getInfo.data.pStorageImage = &imageInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+		getInfo.data.pInputAttachmentImage = &imageInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_SAMPLER:
+		getInfo.data.pSampler = &sampler;
+		break;
+	default:
+		throw std::runtime_error("DescriptorBuffer: unsupported image descriptor type");
+	}
+
+	size_t descriptorSize = getDescriptorSize(context.getDescriptorBufferProperties(), type);
+	context.getDescriptor(getInfo, descriptorSize, getDescriptorAddress(context, set, binding, arrayElement, descriptorSize));
+}
+
+void LibGFX::DescriptorBuffer::bind(VkContext& context, VkCommandBuffer commandBuffer) const
+{
+	VkDescriptorBufferBindingInfoEXT bindingInfo = {};
+	bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+	bindingInfo.address = m_address;
+	bindingInfo.usage = m_usage;
+	context.bindDescriptorBuffers(commandBuffer, 1, &bindingInfo);
+}
+
+void LibGFX::DescriptorBuffer::bindSets(VkContext& context, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet, const std::vector<DescriptorBufferSet>& sets)
+{
+	// Every set comes from the buffer bound at index 0
+	m_bufferIndices.assign(sets.size(), 0);
+	m_offsetScratch.clear();
+	for (const auto& set : sets) {
+		m_offsetScratch.push_back(set.offset);
+	}
+	context.setDescriptorBufferOffsets(commandBuffer, bindPoint, pipelineLayout, firstSet, static_cast<uint32_t>(sets.size()), m_bufferIndices.data(), m_offsetScratch.data());
+}
+
+void* LibGFX::DescriptorBuffer::getDescriptorAddress(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, uint32_t arrayElement, size_t descriptorSize) const
+{
+	VkDeviceSize offset = context.getDescriptorSetLayoutBindingOffset(set.layout, binding) + static_cast<VkDeviceSize>(arrayElement) * descriptorSize;
+	if (offset + descriptorSize > set.size) {
+		throw std::runtime_error("DescriptorBuffer: descriptor is outside of the set");
+	}
+	return static_cast<uint8_t*>(m_buffer.mapped) + set.offset + offset;
+}
+
+size_t LibGFX::DescriptorBuffer::getDescriptorSize(const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties, VkDescriptorType type)
+{
+	switch (type) {
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		return properties.uniformBufferDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		return properties.storageBufferDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		return properties.combinedImageSamplerDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		return properties.sampledImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		return properties.storageImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+		return properties.inputAttachmentDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_SAMPLER:
+		return properties.samplerDescriptorSize;
+	default:
+		throw std::runtime_error("DescriptorBuffer: unsupported descriptor type");
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// A set placed in a DescriptorBuffer, bound by passing its offset to DescriptorBuffer::bindSets
+	struct DescriptorBufferSet {
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+	};
+
+	// Descriptor sets stored in one persistently mapped buffer (VK_EXT_descriptor_buffer). Writes go straight
+	// to memory with vkGetDescriptorEXT and binding a set is only an offset, there are no pools, no
+	// vkUpdateDescriptorSets and no vkAllocateDescriptorSets. The buffer is split into one region per frame
+	// in flight like the UniformRing, use one frame and never call beginFrame for sets that live longer.
+	// Layouts must be built with DescriptorBackend::Buffer and pipelines using them need
+	// VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT. Dynamic buffer descriptors are not supported.
+	class DescriptorBuffer
+	{
+	public:
+		void create(VkContext& context, VkDeviceSize frameSize, uint32_t framesInFlight = 1);
+		void destroy(VkContext& context);
+
+		void beginFrame(uint32_t frameIndex);
+		DescriptorBufferSet allocate(VkContext& context, VkDescriptorSetLayout layout);
+
+		// Buffers need VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VkContext::createBuffer adds it to uniform and storage buffers
+		void writeBuffer(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, VkDescriptorType type, const Buffer& buffer, VkDeviceSize range = VK_WHOLE_SIZE, VkDeviceSize offset = 0, uint32_t arrayElement = 0);
+		void writeImage(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, uint32_t arrayElement = 0);
+
+		// Binds the buffer once per command buffer, afterwards sets are switched with bindSets only
+		void bind(VkContext& context, VkCommandBuffer commandBuffer) const;
+		void bindSets(VkContext& context, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet, const std::vector<DescriptorBufferSet>& sets);
+
+		const Buffer& getBuffer() const { return m_buffer; }
+		VkDeviceSize getUsedBytes() const { return m_head - m_frameStart; }
+	private:
+		Buffer m_buffer = {};
+		VkDeviceAddress m_address = 0;
+		VkBufferUsageFlags m_usage = 0;
+		VkDeviceSize m_alignment = 1;
+		VkDeviceSize m_frameSize = 0;
+		VkDeviceSize m_frameStart = 0;
+		VkDeviceSize m_head = 0;
+		uint32_t m_framesInFlight = 0;
+		std::unordered_map<VkDescriptorSetLayout, VkDeviceSize> m_layoutSizes;
+		std::vector<uint32_t> m_bufferIndices;
+		std::vector<VkDeviceSize> m_offsetScratch;
+
+		void* getDescriptorAddress(VkContext& context, const DescriptorBufferSet& set, uint32_t binding, uint32_t arrayElement, size_t descriptorSize) const;
+		static size_t getDescriptorSize(const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties, VkDescriptorType type);
+	};
+}
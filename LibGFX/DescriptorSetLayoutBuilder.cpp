@@ -1,5 +1,6 @@
 #include "DescriptorSetLayoutBuilder.h"
 #include <stdexcept>
+#include <map>
 
 LibGFX::DescriptorSetLayoutBuilder& LibGFX::DescriptorSetLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t descriptorCount /*= 1*/)
 {
@@ -12,10 +13,28 @@ LibGFX::DescriptorSetLayoutBuilder& LibGFX::DescriptorSetLayoutBuilder::addBindi
 	return *this;
 }
 
-VkDescriptorSetLayout LibGFX::DescriptorSetLayoutBuilder::build(VkContext& context) 
+LibGFX::DescriptorSetLayoutBuilder& LibGFX::DescriptorSetLayoutBuilder::setBindingFlags(uint32_t binding, VkDescriptorBindingFlags bindingFlags)
 {
+	for (auto& bindingInfo : m_bindings) {
+		if (bindingInfo.binding == binding) {
+			bindingInfo.bindingFlags = bindingFlags;
+			return *this;
+		}
+	}
+	throw std::runtime_error("setBindingFlags: binding was not added");
+}
+
+VkDescriptorSetLayout LibGFX::DescriptorSetLayoutBuilder::build(VkContext& context, DescriptorBackend backend /*= DescriptorBackend::Pool*/)
+{
+	if (backend == DescriptorBackend::Buffer && !context.supportsDescriptorBuffer()) {
+		throw std::runtime_error("Failed to create descriptor set layout: descriptor buffers are not supported");
+	}
+
 	std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+	std::vector<VkDescriptorBindingFlags> bindingFlags;
 	layoutBindings.reserve(m_bindings.size());
+	bindingFlags.reserve(m_bindings.size());
+	VkDescriptorBindingFlags combinedFlags = 0;
 
 	for (const auto& bindingInfo : m_bindings) {
 		VkDescriptorSetLayoutBinding layoutBinding = {};
@@ -25,12 +44,29 @@ VkDescriptorSetLayout LibGFX::DescriptorSetLayoutBuilder::build(VkContext& conte
 		layoutBinding.stageFlags = bindingInfo.stageFlags;
 		layoutBinding.pImmutableSamplers = nullptr;
 		layoutBindings.push_back(layoutBinding);
+		bindingFlags.push_back(bindingInfo.bindingFlags);
+		combinedFlags |= bindingInfo.bindingFlags;
 	}
 
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
 	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;	
 	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
 	layoutCreateInfo.pBindings = layoutBindings.data();
+	if (backend == DescriptorBackend::Buffer) {
+		layoutCreateInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+	}
+
+	// Binding flags are only chained when used, so layouts work without descriptor indexing
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+	if (combinedFlags != 0) {
+		layoutCreateInfo.pNext = &bindingFlagsInfo;
+	}
+	if (combinedFlags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) {
+		layoutCreateInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	}
 
 	VkDescriptorSetLayout descriptorSetLayout;
 	if (vkCreateDescriptorSetLayout(context.getDevice(), &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
@@ -39,3 +75,18 @@ VkDescriptorSetLayout LibGFX::DescriptorSetLayoutBuilder::build(VkContext& conte
 
 	return descriptorSetLayout;
 }
+
+std::vector<VkDescriptorPoolSize> LibGFX::DescriptorSetLayoutBuilder::getPoolSizes() const
+{
+	std::map<VkDescriptorType, uint32_t> counts;
+	for (const auto& bindingInfo : m_bindings) {
+		counts[bindingInfo.descriptorType] += bindingInfo.descriptorCount;
+	}
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	poolSizes.reserve(counts.size());
+	for (const auto& [type, count] : counts) {
+		poolSizes.push_back({ type, count });
+	}
+	return poolSizes;
+}
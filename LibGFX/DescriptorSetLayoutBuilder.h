@@ -10,6 +10,7 @@ struct DescriptorBindingInfo
 	VkDescriptorType descriptorType;
 	uint32_t descriptorCount = 1;
 	VkShaderStageFlags stageFlags;
+	VkDescriptorBindingFlags bindingFlags = 0;
 };
 
 namespace LibGFX {
@@ -18,7 +19,12 @@ namespace LibGFX {
 	{
 	public:
 		DescriptorSetLayoutBuilder& addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t descriptorCount = 1);
-		VkDescriptorSetLayout build(VkContext& context);
+		// Descriptor indexing flags of an added binding, UPDATE_AFTER_BIND makes the layout an update after bind layout
+		DescriptorSetLayoutBuilder& setBindingFlags(uint32_t binding, VkDescriptorBindingFlags bindingFlags);
+		// DescriptorBackend::Buffer layouts are only usable with a DescriptorBuffer, not with pools
+		VkDescriptorSetLayout build(VkContext& context, DescriptorBackend backend = DescriptorBackend::Pool);
+		// Descriptor count per type of the layout, e.g. for DescriptorAllocator::registerLayout
+		std::vector<VkDescriptorPoolSize> getPoolSizes() const;
 		void clear() { m_bindings.clear(); }
 	private:
 		std::vector<DescriptorBindingInfo> m_bindings;
@@ -1,4 +1,5 @@
 #include "DescriptorSetWriter.h"
+#include <stdexcept>
 
 LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::addBufferInfo(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
 {
@@ -20,8 +21,80 @@ LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::addImageInfo(VkImageVi
 	return *this;
 }
 
+LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::addTexelBufferView(VkBufferView bufferView)
+{
+	m_texelBufferViews.push_back(bufferView);
+	return *this;
+}
+
+LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::queue(VkDescriptorSet descriptorSet, uint32_t dstBinding, uint32_t dstArrayElement, VkDescriptorType descriptorType)
+{
+	PendingWrite pending = {};
+	pending.kind = getInfoKind(descriptorType);
+
+	// The write covers every info of its kind added since the previous write
+	size_t count = 0;
+	switch (pending.kind) {
+	case InfoKind::Buffer:
+		pending.infoOffset = m_nextBufferInfo;
+		count = m_bufferInfos.size() - m_nextBufferInfo;
+		m_nextBufferInfo = m_bufferInfos.size();
+		break;
+	case InfoKind::Image:
+		pending.infoOffset = m_nextImageInfo;
+		count = m_imageInfos.size() - m_nextImageInfo;
+		m_nextImageInfo = m_imageInfos.size();
+		break;
+	case InfoKind::TexelBuffer:
+		pending.infoOffset = m_nextTexelBufferView;
+		count = m_texelBufferViews.size() - m_nextTexelBufferView;
+		m_nextTexelBufferView = m_texelBufferViews.size();
+		break;
+	}
+
+	if (count == 0) {
+		throw std::runtime_error("DescriptorSetWriter: no descriptor info added for write");
+	}
+
+	pending.write = {};
+	pending.write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	pending.write.dstSet = descriptorSet;
+	pending.write.dstBinding = dstBinding;
+	pending.write.dstArrayElement = dstArrayElement;
+	pending.write.descriptorCount = static_cast<uint32_t>(count);
+	pending.write.descriptorType = descriptorType;
+	m_writes.push_back(pending);
+	return *this;
+}
+
+void LibGFX::DescriptorSetWriter::flush(VkContext& context)
+{
+	if (m_writes.empty()) {
+		return;
+	}
+
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.reserve(m_writes.size());
+	for (const auto& pending : m_writes) {
+		VkWriteDescriptorSet writeInfo = pending.write;
+		setInfo(writeInfo, pending.kind, pending.infoOffset);
+		writes.push_back(writeInfo);
+	}
+
+	vkUpdateDescriptorSets(context.getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	m_writes.clear();
+}
+
 LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::write(VkContext& context, VkDescriptorSet descriptorSet, uint32_t dstBinding, uint32_t dstArrayElement, VkDescriptorType descriptorType)
 {
+	InfoKind kind = getInfoKind(descriptorType);
+	bool hasInfo = (kind == InfoKind::Buffer && !m_bufferInfos.empty())
+		|| (kind == InfoKind::Image && !m_imageInfos.empty())
+		|| (kind == InfoKind::TexelBuffer && !m_texelBufferViews.empty());
+	if (!hasInfo) {
+		throw std::runtime_error("DescriptorSetWriter: no descriptor info added for write");
+	}
+
 	VkWriteDescriptorSet writeInfo = {};
 	writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	writeInfo.dstSet = descriptorSet;
@@ -29,9 +102,7 @@ LibGFX::DescriptorSetWriter& LibGFX::DescriptorSetWriter::write(VkContext& conte
 	writeInfo.dstArrayElement = dstArrayElement;
 	writeInfo.descriptorCount = 1;
 	writeInfo.descriptorType = descriptorType;
-
-	writeInfo.pBufferInfo = m_bufferInfos.empty() ? nullptr : m_bufferInfos.data();
-	writeInfo.pImageInfo = m_imageInfos.empty() ? nullptr : m_imageInfos.data();
+	setInfo(writeInfo, kind, 0);
 
 	vkUpdateDescriptorSets(context.getDevice(), 1, &writeInfo, 0, nullptr);
 	return *this;
@@ -41,4 +112,47 @@ void LibGFX::DescriptorSetWriter::clear()
 {
 	m_bufferInfos.clear();
 	m_imageInfos.clear();
+	m_texelBufferViews.clear();
+	m_writes.clear();
+	m_nextBufferInfo = 0;
+	m_nextImageInfo = 0;
+	m_nextTexelBufferView = 0;
+}
+
+void LibGFX::DescriptorSetWriter::setInfo(VkWriteDescriptorSet& write, InfoKind kind, size_t infoOffset) const
+{
+	switch (kind) {
+	case InfoKind::Buffer:
+		write.pBufferInfo = m_bufferInfos.data() + infoOffset;
+		break;
+	case InfoKind::Image:
+		write.pImageInfo = m_imageInfos.data() + infoOffset;
+		break;
+	case InfoKind::TexelBuffer:
+		write.pTexelBufferView = m_texelBufferViews.data() + infoOffset;
+		break;
+	}
+}
+
+LibGFX::DescriptorSetWriter::InfoKind LibGFX::DescriptorSetWriter::getInfoKind(VkDescriptorType descriptorType)
+{
+	switch (descriptorType) {
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+		return InfoKind::Buffer;
+	case VK_DESCRIPTOR_TYPE_SAMPLER:
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+	case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+		return InfoKind::Image;
+	case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+	case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+		return InfoKind::TexelBuffer;
+	default:
+		// Inline uniform blocks and acceleration structures need pNext structs the writer does not build
+		throw std::runtime_error("DescriptorSetWriter: unsupported descriptor type, only buffer, image and texel buffer descriptors can be written");
+	}
 }
@@ -4,15 +4,45 @@
 #include "VkContext.h"
 
 namespace LibGFX {
+	// Collects descriptor writes for any number of sets and applies them with one vkUpdateDescriptorSets call.
+	// The infos of a kind added since the previous queued write belong to the next queued write.
+	// Infos stay until clear(), flush only drops the queued writes.
 	class DescriptorSetWriter
 	{
 	public:
 		DescriptorSetWriter& addBufferInfo(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
 		DescriptorSetWriter& addImageInfo(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+		// For UNIFORM_TEXEL_BUFFER and STORAGE_TEXEL_BUFFER descriptors
+		DescriptorSetWriter& addTexelBufferView(VkBufferView bufferView);
+		DescriptorSetWriter& queue(VkDescriptorSet descriptorSet, uint32_t dstBinding, uint32_t dstArrayElement, VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		void flush(VkContext& context);
+		// Writes a single descriptor right away from the first info of its kind, queued writes are not touched
 		DescriptorSetWriter& write(VkContext& context, VkDescriptorSet descriptorSet, uint32_t dstBinding, uint32_t dstArrayElement, VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 		void clear();
+		size_t getPendingWriteCount() const { return m_writes.size(); }
 	private:
+		enum class InfoKind {
+			Buffer,
+			Image,
+			TexelBuffer
+		};
+
+		// Info arrays may grow while writes are queued, so writes keep offsets until flush
+		struct PendingWrite {
+			VkWriteDescriptorSet write;
+			size_t infoOffset;
+			InfoKind kind;
+		};
+
 		std::vector<VkDescriptorBufferInfo> m_bufferInfos;
 		std::vector<VkDescriptorImageInfo> m_imageInfos;
+		std::vector<VkBufferView> m_texelBufferViews;
+		std::vector<PendingWrite> m_writes;
+		size_t m_nextBufferInfo = 0;
+		size_t m_nextImageInfo = 0;
+		size_t m_nextTexelBufferView = 0;
+
+		void setInfo(VkWriteDescriptorSet& write, InfoKind kind, size_t infoOffset) const;
+		static InfoKind getInfoKind(VkDescriptorType descriptorType);
 	};
 }
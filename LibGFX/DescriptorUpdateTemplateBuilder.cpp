@@ -0,0 +1,51 @@
+#include "DescriptorUpdateTemplateBuilder.h"
+#include <stdexcept>
+
+LibGFX::DescriptorUpdateTemplateBuilder& LibGFX::DescriptorUpdateTemplateBuilder::addEntry(uint32_t binding, VkDescriptorType descriptorType, size_t offset, uint32_t descriptorCount /*= 1*/, size_t stride /*= 0*/, uint32_t dstArrayElement /*= 0*/)
+{
+	// Tightly packed infos if no stride is given
+	if (stride == 0) {
+		switch (descriptorType) {
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			stride = sizeof(VkDescriptorImageInfo);
+			break;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			stride = sizeof(VkBufferView);
+			break;
+		default:
+			stride = sizeof(VkDescriptorBufferInfo);
+			break;
+		}
+	}
+
+	VkDescriptorUpdateTemplateEntry entry = {};
+	entry.dstBinding = binding;
+	entry.dstArrayElement = dstArrayElement;
+	entry.descriptorCount = descriptorCount;
+	entry.descriptorType = descriptorType;
+	entry.offset = offset;
+	entry.stride = stride;
+	m_entries.push_back(entry);
+	return *this;
+}
+
+VkDescriptorUpdateTemplate LibGFX::DescriptorUpdateTemplateBuilder::build(VkContext& context, VkDescriptorSetLayout descriptorSetLayout)
+{
+	VkDescriptorUpdateTemplateCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(m_entries.size());
+	createInfo.pDescriptorUpdateEntries = m_entries.data();
+	createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	createInfo.descriptorSetLayout = descriptorSetLayout;
+
+	VkDescriptorUpdateTemplate updateTemplate;
+	if (vkCreateDescriptorUpdateTemplate(context.getDevice(), &createInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor update template");
+	}
+	return updateTemplate;
+}
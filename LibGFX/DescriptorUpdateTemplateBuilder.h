@@ -0,0 +1,18 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "VkContext.h"
+
+namespace LibGFX {
+	// Builder for descriptor update templates. Every entry reads its descriptor infos from
+	// offset (+ stride per array element) inside the packed struct passed to VkContext::updateDescriptorSetWithTemplate.
+	class DescriptorUpdateTemplateBuilder
+	{
+	public:
+		DescriptorUpdateTemplateBuilder& addEntry(uint32_t binding, VkDescriptorType descriptorType, size_t offset, uint32_t descriptorCount = 1, size_t stride = 0, uint32_t dstArrayElement = 0);
+		VkDescriptorUpdateTemplate build(VkContext& context, VkDescriptorSetLayout descriptorSetLayout);
+		void clear() { m_entries.clear(); }
+	private:
+		std::vector<VkDescriptorUpdateTemplateEntry> m_entries;
+	};
+}
@@ -0,0 +1,275 @@
+#include "FrameRing.h"
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+void LibGFX::FrameRing::create(VkContext& context, uint32_t framesInFlight /*= DEFAULT_FRAMES_IN_FLIGHT*/)
+{
+	if (framesInFlight == 0) {
+		throw std::runtime_error("FrameRing: at least one frame in flight is required");
+	}
+
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	m_frames.resize(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		FrameContext& frame = m_frames[i];
+		frame.frameIndex = i;
+		frame.commandPool = context.createCommandPool(static_cast<uint32_t>(indices.graphicsFamily), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		frame.commandBuffer = context.allocateCommandBuffer(frame.commandPool);
+		// Signaled so the first wait of every frame returns immediately
+		frame.inFlightFence = context.createFence(VK_FENCE_CREATE_SIGNALED_BIT);
+		frame.imageAvailableSemaphore = context.createSemaphore();
+	}
+
+	m_currentFrame = 0;
+	resetStats();
+}
+
+void LibGFX::FrameRing::destroy(VkContext& context)
+{
+	waitIdle(context);
+	for (auto& frame : m_frames) {
+		context.destroySemaphore(frame.imageAvailableSemaphore);
+		context.destroyFence(frame.inFlightFence);
+		// Destroying the pool frees its command buffer
+		context.destroyCommandPool(frame.commandPool);
+	}
+	m_frames.clear();
+	m_pendingPresents.clear();
+	retireSwapchainSemaphores(context);
+	m_currentFrame = 0;
+}
+
+bool LibGFX::FrameRing::beginFrame(VkContext& context, const SwapchainInfo& swapchainInfo)
+{
+	FrameContext& frame = m_frames[m_currentFrame];
+	waitForFrame(context, frame);
+	collectPresents(context, swapchainInfo.swapchain);
+	updateSwapchainSemaphores(context, swapchainInfo);
+
+	auto acquireStart = Clock::now();
+	VkResult result;
+	{
+		TraceScope traceScope(context.getTraceRecorder(), "acquireNextImage", "wait");
+		result = context.acquireNextImage(swapchainInfo, frame.imageAvailableSemaphore, VK_NULL_HANDLE, frame.imageIndex);
+	}
+	double acquireMs = std::chrono::duration<double, std::milli>(Clock::now() - acquireStart).count();
+	m_stats.lastAcquireMs = acquireMs;
+	m_stats.totalAcquireMs += acquireMs;
+	m_stats.maxAcquireMs = std::max(m_stats.maxAcquireMs, acquireMs);
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		return false;
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+		throw std::runtime_error("Failed to acquire swapchain image");
+	}
+
+	// Only reset the fence once work will be submitted for it
+	frame.renderFinishedSemaphore = m_renderFinishedSemaphores[frame.imageIndex];
+	beginRecording(context, frame);
+	return true;
+}
+
+VkResult LibGFX::FrameRing::endFrame(VkContext& context, const SwapchainInfo& swapchainInfo)
+{
+	FrameContext& frame = m_frames[m_currentFrame];
+	submit(context, frame, true);
+
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &frame.renderFinishedSemaphore;
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &swapchainInfo.swapchain;
+	presentInfo.pImageIndices = &frame.imageIndex;
+
+	// Tag the present so its display time can be waited on
+	uint64_t presentId = m_nextPresentId;
+	VkPresentIdKHR presentIdInfo = {};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &presentId;
+	if (context.supportsPresentWait()) {
+		presentInfo.pNext = &presentIdInfo;
+	}
+
+	auto presentTime = Clock::now();
+	VkResult result;
+	{
+		TraceScope traceScope(context.getTraceRecorder(), "vkQueuePresentKHR", "submit");
+		result = context.tryQueuePresent(presentInfo);
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+		throw std::runtime_error("Failed to present image");
+	}
+
+	if (m_stats.presentCount > 0) {
+		double intervalMs = std::chrono::duration<double, std::milli>(presentTime - m_lastPresentTime).count();
+		m_stats.lastPresentIntervalMs = intervalMs;
+		m_stats.totalPresentIntervalMs += intervalMs;
+		m_stats.maxPresentIntervalMs = std::max(m_stats.maxPresentIntervalMs, intervalMs);
+	}
+	m_stats.presentCount++;
+	m_lastPresentTime = presentTime;
+
+	// Ids must increase strictly, an id passed with an out of date present may still have been used
+	if (context.supportsPresentWait()) {
+		if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+			m_pendingPresents.push_back({ swapchainInfo.swapchain, presentId, presentTime });
+		}
+		m_nextPresentId++;
+	}
+
+	m_currentFrame = (m_currentFrame + 1) % static_cast<uint32_t>(m_frames.size());
+	return result;
+}
+
+void LibGFX::FrameRing::beginFrame(VkContext& context)
+{
+	FrameContext& frame = m_frames[m_currentFrame];
+	waitForFrame(context, frame);
+	beginRecording(context, frame);
+}
+
+void LibGFX::FrameRing::endFrame(VkContext& context)
+{
+	submit(context, m_frames[m_currentFrame], false);
+	m_currentFrame = (m_currentFrame + 1) % static_cast<uint32_t>(m_frames.size());
+}
+
+void LibGFX::FrameRing::waitIdle(VkContext& context)
+{
+	for (auto& frame : m_frames) {
+		context.waitForFence(frame.inFlightFence);
+	}
+}
+
+void LibGFX::FrameRing::resetStats()
+{
+	m_stats = FrameStats();
+	m_pendingPresents.clear();
+}
+
+void LibGFX::FrameRing::collectPresents(VkContext& context, VkSwapchainKHR swapchain)
+{
+	if (!context.supportsPresentWait()) {
+		return;
+	}
+
+	while (!m_pendingPresents.empty()) {
+		PendingPresent& pending = m_pendingPresents.front();
+		// Ids of a retired swapchain can no longer be waited on
+		if (pending.swapchain != swapchain) {
+			m_pendingPresents.pop_front();
+			continue;
+		}
+
+		// Block only while more presents are queued than the latency limit allows
+		bool throttle = m_maxPresentLatency > 0 && m_pendingPresents.size() > m_maxPresentLatency;
+		uint64_t timeout = throttle ? 1000000000ull : 0;
+		VkResult result = context.waitForPresent(swapchain, pending.presentId, timeout);
+		if (result == VK_TIMEOUT) {
+			if (throttle) {
+				// Display is stalled, give up on the limit for this frame rather than hang
+				m_pendingPresents.pop_front();
+			}
+			break;
+		}
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			// Out of date or surface lost, the swapchain recreation takes care of it
+			m_pendingPresents.clear();
+			break;
+		}
+
+		// Polled ids are observed late, so the latency is an upper bound unless the wait blocked
+		double latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - pending.submitTime).count();
+		m_stats.presentLatencyCount++;
+		m_stats.lastPresentLatencyMs = latencyMs;
+		m_stats.totalPresentLatencyMs += latencyMs;
+		m_stats.maxPresentLatencyMs = std::max(m_stats.maxPresentLatencyMs, latencyMs);
+		m_pendingPresents.pop_front();
+	}
+}
+
+void LibGFX::FrameRing::waitForFrame(VkContext& context, FrameContext& frame)
+{
+	auto start = std::chrono::steady_clock::now();
+	context.waitForFence(frame.inFlightFence);
+	auto end = std::chrono::steady_clock::now();
+
+	// Resources retired by a swapchain recreation are freed as their frames drain
+	context.collectRetiredResources();
+
+	// Frame boundary for the per frame trace counters
+	if (context.getTraceRecorder() != nullptr) {
+		context.getTraceRecorder()->markFrame();
+	}
+
+	double waitMs = std::chrono::duration<double, std::milli>(end - start).count();
+	m_stats.frameCount++;
+	m_stats.lastWaitMs = waitMs;
+	m_stats.totalWaitMs += waitMs;
+	m_stats.maxWaitMs = std::max(m_stats.maxWaitMs, waitMs);
+}
+
+void LibGFX::FrameRing::beginRecording(VkContext& context, FrameContext& frame)
+{
+	context.resetFence(frame.inFlightFence);
+
+	// All command buffers of the frame are recycled at once
+	if (vkResetCommandPool(context.getDevice(), frame.commandPool, 0) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to reset frame command pool");
+	}
+	context.beginCommandBuffer(frame.commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+}
+
+void LibGFX::FrameRing::updateSwapchainSemaphores(VkContext& context, const SwapchainInfo& swapchainInfo)
+{
+	if (swapchainInfo.swapchain == m_swapchain && m_renderFinishedSemaphores.size() == swapchainInfo.images.size()) {
+		return;
+	}
+
+	retireSwapchainSemaphores(context);
+	m_renderFinishedSemaphores = context.createSemaphores(static_cast<uint32_t>(swapchainInfo.images.size()));
+	m_swapchain = swapchainInfo.swapchain;
+}
+
+void LibGFX::FrameRing::retireSwapchainSemaphores(VkContext& context)
+{
+	// Presents of the old swapchain may still wait on the semaphores, they go with the retired swapchain
+	context.retireSemaphores(m_renderFinishedSemaphores);
+	m_swapchain = VK_NULL_HANDLE;
+}
+
+void LibGFX::FrameRing::addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags waitStage)
+{
+	m_waitSemaphores.push_back(semaphore);
+	m_waitStages.push_back(waitStage);
+}
+
+void LibGFX::FrameRing::submit(VkContext& context, FrameContext& frame, bool present)
+{
+	context.endCommandBuffer(frame.commandBuffer);
+
+	if (present) {
+		m_waitSemaphores.push_back(frame.imageAvailableSemaphore);
+		m_waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(m_waitSemaphores.size());
+	submitInfo.pWaitSemaphores = m_waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = m_waitStages.data();
+	if (present) {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &frame.renderFinishedSemaphore;
+	}
+	context.submitCommandBuffer(submitInfo, frame.inFlightFence);
+
+	m_waitSemaphores.clear();
+	m_waitStages.clear();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Per frame resources, reused once the fence of the frame has signaled
+	struct FrameContext {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence inFlightFence = VK_NULL_HANDLE;
+		VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+		VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;	// Owned per swapchain image, set for the acquired image
+		uint32_t frameIndex = 0;
+		uint32_t imageIndex = 0;
+	};
+
+	// Frame pacing telemetry: time blocked on frame fences and image acquisition,
+	// the interval between presents and, with VK_KHR_present_wait, the submit to display latency
+	struct FrameStats {
+		uint64_t frameCount = 0;
+		double lastWaitMs = 0.0;
+		double maxWaitMs = 0.0;
+		double totalWaitMs = 0.0;
+
+		double lastAcquireMs = 0.0;
+		double maxAcquireMs = 0.0;
+		double totalAcquireMs = 0.0;
+
+		uint64_t presentCount = 0;
+		double lastPresentIntervalMs = 0.0;
+		double maxPresentIntervalMs = 0.0;
+		double totalPresentIntervalMs = 0.0;
+
+		uint64_t presentLatencyCount = 0;
+		double lastPresentLatencyMs = 0.0;
+		double maxPresentLatencyMs = 0.0;
+		double totalPresentLatencyMs = 0.0;
+
+		double getAverageWaitMs() const {
+			return frameCount > 0 ? totalWaitMs / static_cast<double>(frameCount) : 0.0;
+		}
+
+		double getAverageAcquireMs() const {
+			return frameCount > 0 ? totalAcquireMs / static_cast<double>(frameCount) : 0.0;
+		}
+
+		// The first present has no predecessor and is not part of the average
+		double getAveragePresentIntervalMs() const {
+			return presentCount > 1 ? totalPresentIntervalMs / static_cast<double>(presentCount - 1) : 0.0;
+		}
+
+		double getAveragePresentLatencyMs() const {
+			return presentLatencyCount > 0 ? totalPresentLatencyMs / static_cast<double>(presentLatencyCount) : 0.0;
+		}
+	};
+
+	// Ring of N frames in flight. Every frame owns a transient command pool that is reset as a whole,
+	// a fence and its acquire semaphore. Render finished semaphores belong to the swapchain images, a present
+	// may still wait on one when its frame comes around again. They are recreated when the swapchain changes,
+	// the old ones are retired through VkContext like the old swapchain, so call collectRetiredResources.
+	class FrameRing
+	{
+	public:
+		static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+		void create(VkContext& context, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+		void destroy(VkContext& context);
+
+		// Waits for the frame, acquires the next swapchain image and begins the command buffer.
+		// Returns false if the swapchain is out of date, the frame is left untouched in that case.
+		bool beginFrame(VkContext& context, const SwapchainInfo& swapchainInfo);
+		// Submits the command buffer and presents, returns the present result (SUBOPTIMAL / OUT_OF_DATE ask for a recreate)
+		VkResult endFrame(VkContext& context, const SwapchainInfo& swapchainInfo);
+
+		// Headless variants without image acquisition and presentation
+		void beginFrame(VkContext& context);
+		void endFrame(VkContext& context);
+
+		void waitIdle(VkContext& context);
+		FrameContext& getCurrentFrame() { return m_frames[m_currentFrame]; }
+		VkCommandBuffer getCommandBuffer() const { return m_frames[m_currentFrame].commandBuffer; }
+		uint32_t getFrameIndex() const { return m_currentFrame; }
+		uint32_t getFramesInFlight() const { return static_cast<uint32_t>(m_frames.size()); }
+		const FrameStats& getStats() const { return m_stats; }
+		void resetStats();
+
+		// Extra semaphore the next endFrame submission waits on, e.g. the signal of an async compute submission
+		void addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags waitStage);
+
+		// Limits the number of presents queued ahead of the display (0 = unlimited).
+		// Requires VK_KHR_present_wait, ignored otherwise.
+		void setMaxPresentLatency(uint32_t frames) { m_maxPresentLatency = frames; }
+		uint32_t getMaxPresentLatency() const { return m_maxPresentLatency; }
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct PendingPresent {
+			VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+			uint64_t presentId = 0;
+			Clock::time_point submitTime;
+		};
+
+		std::vector<FrameContext> m_frames;
+		uint32_t m_currentFrame = 0;
+		FrameStats m_stats;
+		uint32_t m_maxPresentLatency = 0;
+		uint64_t m_nextPresentId = 1;
+		Clock::time_point m_lastPresentTime;
+		std::deque<PendingPresent> m_pendingPresents;
+		std::vector<VkSemaphore> m_renderFinishedSemaphores;	// One per swapchain image
+		VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+		std::vector<VkSemaphore> m_waitSemaphores;
+		std::vector<VkPipelineStageFlags> m_waitStages;
+
+		void collectPresents(VkContext& context, VkSwapchainKHR swapchain);
+		void updateSwapchainSemaphores(VkContext& context, const SwapchainInfo& swapchainInfo);
+		void retireSwapchainSemaphores(VkContext& context);
+
+		void waitForFrame(VkContext& context, FrameContext& frame);
+		void beginRecording(VkContext& context, FrameContext& frame);
+		void submit(VkContext& context, FrameContext& frame, bool present);
+	};
+}
@@ -0,0 +1,213 @@
+#include "GpuProfiler.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+void LibGFX::GpuProfiler::create(VkContext& context, uint32_t framesInFlight, uint32_t maxScopes /*= DEFAULT_MAX_SCOPES*/)
+{
+	if (framesInFlight == 0 || maxScopes == 0) {
+		throw std::runtime_error("GpuProfiler: frame and scope count must not be zero");
+	}
+
+	// Timestamps need support on the graphics queue family and a non zero period
+	const VkPhysicalDeviceProperties& properties = context.getPhysicalDeviceProperties();
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(context.getPhysicalDevice(), &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(context.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+	uint32_t validBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+
+	m_supported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+	m_enabled = m_supported;
+	m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+	m_timestampPeriod = properties.limits.timestampPeriod;
+	m_maxScopes = maxScopes;
+	m_droppedScopes = 0;
+	m_frameCounter = 0;
+	m_hasTimings = false;
+	m_frames.resize(framesInFlight);
+	if (!m_supported) {
+		return;
+	}
+
+	// Two queries per scope, each followed by its availability value
+	m_queryResults.resize(static_cast<size_t>(maxScopes) * 2 * 2);
+	for (auto& frame : m_frames) {
+		VkQueryPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = maxScopes * 2;
+		if (vkCreateQueryPool(context.getDevice(), &poolInfo, nullptr, &frame.queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+		frame.scopes.reserve(maxScopes);
+	}
+}
+
+void LibGFX::GpuProfiler::destroy(VkContext& context)
+{
+	for (auto& frame : m_frames) {
+		if (frame.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(context.getDevice(), frame.queryPool, nullptr);
+		}
+	}
+	m_frames.clear();
+	m_scopeStack.clear();
+	m_queryResults.clear();
+	m_recordingFrame = nullptr;
+	m_supported = false;
+	m_enabled = false;
+}
+
+void LibGFX::GpuProfiler::beginFrame(VkContext& context, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	m_recordingFrame = nullptr;
+	if (!m_enabled) {
+		return;
+	}
+
+	// The frame fence has signaled at this point, the results of the slot are normally ready
+	ProfilerFrame& frame = m_frames[frameIndex];
+	if (frame.pending) {
+		resolveFrame(context, frame);
+	}
+
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, m_maxScopes * 2);
+	frame.scopes.clear();
+	frame.pending = false;
+	m_scopeStack.clear();
+	m_recordingFrame = &frame;
+}
+
+void LibGFX::GpuProfiler::endFrame()
+{
+	if (m_recordingFrame == nullptr) {
+		return;
+	}
+	if (!m_scopeStack.empty()) {
+		throw std::runtime_error("GpuProfiler: frame ended with open scopes");
+	}
+
+	m_recordingFrame->frameNumber = m_frameCounter++;
+	m_recordingFrame->pending = !m_recordingFrame->scopes.empty();
+	m_recordingFrame = nullptr;
+}
+
+void LibGFX::GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (m_recordingFrame == nullptr) {
+		return;
+	}
+
+	// Keep begin / end balanced when the query pool is exhausted
+	auto& scopes = m_recordingFrame->scopes;
+	if (scopes.size() >= m_maxScopes) {
+		m_droppedScopes++;
+		m_scopeStack.push_back(DROPPED_SCOPE);
+		return;
+	}
+
+	Scope scope;
+	scope.name = name;
+	scope.depth = static_cast<uint32_t>(m_scopeStack.size());
+	for (auto it = m_scopeStack.rbegin(); it != m_scopeStack.rend(); ++it) {
+		if (*it != DROPPED_SCOPE) {
+			scope.parent = static_cast<int32_t>(*it);
+			break;
+		}
+	}
+
+	uint32_t scopeIndex = static_cast<uint32_t>(scopes.size());
+	scopes.push_back(std::move(scope));
+	m_scopeStack.push_back(scopeIndex);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_recordingFrame->queryPool, scopeIndex * 2);
+}
+
+void LibGFX::GpuProfiler::endScope(VkCommandBuffer commandBuffer)
+{
+	if (m_recordingFrame == nullptr) {
+		return;
+	}
+	if (m_scopeStack.empty()) {
+		throw std::runtime_error("GpuProfiler: endScope without matching beginScope");
+	}
+
+	uint32_t scopeIndex = m_scopeStack.back();
+	m_scopeStack.pop_back();
+	if (scopeIndex != DROPPED_SCOPE) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_recordingFrame->queryPool, scopeIndex * 2 + 1);
+	}
+}
+
+void LibGFX::GpuProfiler::beginRenderPass(VkContext& context, VkCommandBuffer commandBuffer, const char* name, const RenderPass& renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkSubpassContents contents /*= VK_SUBPASS_CONTENTS_INLINE*/)
+{
+	beginScope(commandBuffer, name);
+	context.beginRenderPass(commandBuffer, renderPass, framebuffer, extent, contents);
+}
+
+void LibGFX::GpuProfiler::endRenderPass(VkContext& context, VkCommandBuffer commandBuffer)
+{
+	context.endRenderPass(commandBuffer);
+	endScope(commandBuffer);
+}
+
+bool LibGFX::GpuProfiler::resolveFrame(VkContext& context, ProfilerFrame& frame)
+{
+	frame.pending = false;
+	uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+
+	// No wait flag, a frame whose queries are not available yet is skipped
+	VkResult result = vkGetQueryPoolResults(context.getDevice(), frame.queryPool, 0, queryCount,
+		sizeof(uint64_t) * 2 * queryCount, m_queryResults.data(), sizeof(uint64_t) * 2,
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY) {
+		return false;
+	}
+
+	GpuFrameTimings timings;
+	timings.frameNumber = frame.frameNumber;
+	timings.scopes.reserve(frame.scopes.size());
+
+	uint64_t frameStart = ~0ull;
+	uint64_t frameEnd = 0;
+	for (uint32_t i = 0; i < queryCount; i++) {
+		if (m_queryResults[i * 2 + 1] == 0) {
+			return false;
+		}
+		uint64_t timestamp = m_queryResults[i * 2] & m_timestampMask;
+		frameStart = std::min(frameStart, timestamp);
+		frameEnd = std::max(frameEnd, timestamp);
+	}
+
+	double nsToMs = m_timestampPeriod / 1000000.0;
+	for (size_t i = 0; i < frame.scopes.size(); i++) {
+		uint64_t begin = m_queryResults[i * 4] & m_timestampMask;
+		uint64_t end = m_queryResults[i * 4 + 2] & m_timestampMask;
+
+		GpuTimingScope scope;
+		scope.name = frame.scopes[i].name;
+		scope.depth = frame.scopes[i].depth;
+		scope.parent = frame.scopes[i].parent;
+		scope.startMs = static_cast<double>(begin - frameStart) * nsToMs;
+		scope.durationMs = end > begin ? static_cast<double>(end - begin) * nsToMs : 0.0;
+		timings.scopes.push_back(std::move(scope));
+	}
+	timings.totalMs = static_cast<double>(frameEnd - frameStart) * nsToMs;
+
+	m_lastTimings = std::move(timings);
+	m_hasTimings = true;
+	return true;
+}
+
+std::string LibGFX::GpuProfiler::format(const GpuFrameTimings& timings)
+{
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(3);
+	stream << "GPU frame " << timings.frameNumber << ": " << timings.totalMs << " ms\n";
+	for (const auto& scope : timings.scopes) {
+		stream << std::string((scope.depth + 1) * 2, ' ') << scope.name << ": " << scope.durationMs << " ms\n";
+	}
+	return stream.str();
+}
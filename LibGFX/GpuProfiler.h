@@ -0,0 +1,107 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Resolved timing of one profiler scope, times are relative to the first timestamp of the frame
+	struct GpuTimingScope {
+		std::string name;
+		uint32_t depth = 0;
+		int32_t parent = -1; // Index into GpuFrameTimings::scopes, -1 for root scopes
+		double startMs = 0.0;
+		double durationMs = 0.0;
+	};
+
+	// Timing tree of one frame, scopes are stored depth first in recording order
+	struct GpuFrameTimings {
+		uint64_t frameNumber = 0;
+		double totalMs = 0.0;
+		std::vector<GpuTimingScope> scopes;
+	};
+
+	// GPU profiler based on timestamp queries. Every frame in flight owns a query pool,
+	// results are read back without waiting when the frame slot comes around again.
+	class GpuProfiler
+	{
+	public:
+		static constexpr uint32_t DEFAULT_MAX_SCOPES = 256;
+
+		void create(VkContext& context, uint32_t framesInFlight, uint32_t maxScopes = DEFAULT_MAX_SCOPES);
+		void destroy(VkContext& context);
+
+		// Reads back the results previously recorded into this frame slot and resets its queries.
+		// Must be recorded outside of a render pass, right after the command buffer begins.
+		void beginFrame(VkContext& context, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void endFrame();
+
+		void beginScope(VkCommandBuffer commandBuffer, const char* name);
+		void endScope(VkCommandBuffer commandBuffer);
+
+		// Render pass wrapped into a scope of the same name
+		void beginRenderPass(VkContext& context, VkCommandBuffer commandBuffer, const char* name, const RenderPass& renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		void endRenderPass(VkContext& context, VkCommandBuffer commandBuffer);
+
+		void setEnabled(bool enabled) { m_enabled = enabled && m_supported; }
+		bool isEnabled() const { return m_enabled; }
+		bool isSupported() const { return m_supported; }
+
+		// Latest frame whose results were available, empty until the first frame slot is reused
+		const GpuFrameTimings& getLastTimings() const { return m_lastTimings; }
+		bool hasTimings() const { return m_hasTimings; }
+		uint32_t getDroppedScopeCount() const { return m_droppedScopes; }
+
+		static std::string format(const GpuFrameTimings& timings);
+	private:
+		struct Scope {
+			std::string name;
+			uint32_t depth = 0;
+			int32_t parent = -1;
+		};
+
+		struct ProfilerFrame {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::vector<Scope> scopes;
+			uint64_t frameNumber = 0;
+			bool pending = false;
+		};
+
+		static constexpr uint32_t DROPPED_SCOPE = ~0u;
+
+		std::vector<ProfilerFrame> m_frames;
+		std::vector<uint32_t> m_scopeStack;
+		std::vector<uint64_t> m_queryResults;
+		ProfilerFrame* m_recordingFrame = nullptr;
+		uint32_t m_maxScopes = 0;
+		uint32_t m_droppedScopes = 0;
+		uint64_t m_frameCounter = 0;
+		uint64_t m_timestampMask = 0;
+		double m_timestampPeriod = 1.0;
+		bool m_supported = false;
+		bool m_enabled = false;
+		GpuFrameTimings m_lastTimings;
+		bool m_hasTimings = false;
+
+		bool resolveFrame(VkContext& context, ProfilerFrame& frame);
+	};
+
+	// Scope guard for GpuProfiler::beginScope / endScope
+	class GpuProfileScope
+	{
+	public:
+		GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+			: m_profiler(profiler), m_commandBuffer(commandBuffer) {
+			m_profiler.beginScope(m_commandBuffer, name);
+		}
+		~GpuProfileScope() {
+			m_profiler.endScope(m_commandBuffer);
+		}
+		GpuProfileScope(const GpuProfileScope&) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+	private:
+		GpuProfiler& m_profiler;
+		VkCommandBuffer m_commandBuffer;
+	};
+}
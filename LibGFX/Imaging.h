@@ -1,12 +1,15 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <cassert>
+#include <cstring>
 #include <vector>
 #include <array>
+#include "MemoryAllocation.h"
 
 namespace LibGFX {
 
-	inline uint32_t getBytesPerPixel(VkFormat format) {
+	// Bytes per pixel of an uncompressed format, 0 if the format is unknown
+	inline uint32_t getKnownBytesPerPixel(VkFormat format) {
 		switch (format) {
 
 			// 1 Channel Formats
@@ -66,6 +69,11 @@ namespace LibGFX {
 		case VK_FORMAT_R8G8B8A8_UINT:
 		case VK_FORMAT_R8G8B8A8_SINT:
 		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
 			return 4;
 		case VK_FORMAT_R16G16B16A16_UNORM:
 		case VK_FORMAT_R16G16B16A16_SNORM:
@@ -79,22 +87,241 @@ namespace LibGFX {
 			return 16;
 
 		default:
-			assert(false && "Unsupported VkFormat in getBytesPerPixel");
 			return 0;
 		}
 	}
 
+	inline uint32_t getBytesPerPixel(VkFormat format) {
+		uint32_t bytesPerPixel = getKnownBytesPerPixel(format);
+		assert(bytesPerPixel != 0 && "Unsupported VkFormat in getBytesPerPixel");
+		return bytesPerPixel;
+	}
+
+	// Texel block of a format, uncompressed formats have 1x1 blocks of one pixel
+	struct FormatBlockInfo {
+		uint32_t width = 1;
+		uint32_t height = 1;
+		uint32_t size = 0;	// Bytes per block
+	};
+
+	// Block extent and size of block-compressed formats, size is 0 for uncompressed formats
+	inline FormatBlockInfo getCompressedBlockInfo(VkFormat format) {
+		switch (format) {
+
+			// BC (desktop)
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return { 4, 4, 16 };
+
+			// ETC2 / EAC (mobile)
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+		case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+		case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+			return { 4, 4, 16 };
+
+			// ASTC, always 16 bytes per block
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:
+			return { 5, 4, 16 };
+		case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+			return { 5, 5, 16 };
+		case VK_FORMAT_ASTC_6x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:
+			return { 6, 5, 16 };
+		case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+			return { 6, 6, 16 };
+		case VK_FORMAT_ASTC_8x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:
+			return { 8, 5, 16 };
+		case VK_FORMAT_ASTC_8x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:
+			return { 8, 6, 16 };
+		case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+			return { 8, 8, 16 };
+		case VK_FORMAT_ASTC_10x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:
+			return { 10, 5, 16 };
+		case VK_FORMAT_ASTC_10x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:
+			return { 10, 6, 16 };
+		case VK_FORMAT_ASTC_10x8_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:
+			return { 10, 8, 16 };
+		case VK_FORMAT_ASTC_10x10_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
+			return { 10, 10, 16 };
+		case VK_FORMAT_ASTC_12x10_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
+			return { 12, 10, 16 };
+		case VK_FORMAT_ASTC_12x12_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+			return { 12, 12, 16 };
+
+		default:
+			return { 1, 1, 0 };
+		}
+	}
+
+	inline bool isCompressedFormat(VkFormat format) {
+		return getCompressedBlockInfo(format).size != 0;
+	}
+
+	// Whether the size helpers below know the format, check before sizing formats from untrusted input
+	inline bool isFormatSizeKnown(VkFormat format) {
+		return isCompressedFormat(format) || getKnownBytesPerPixel(format) != 0;
+	}
+
+	inline FormatBlockInfo getFormatBlockInfo(VkFormat format) {
+		FormatBlockInfo info = getCompressedBlockInfo(format);
+		if (info.size == 0) {
+			info.size = getBytesPerPixel(format);
+		}
+		return info;
+	}
+
+	// Aspects of a depth format, barriers and attachment views of combined formats need both
+	inline VkImageAspectFlags getDepthAspect(VkFormat format) {
+		if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		if (format == VK_FORMAT_S8_UINT) {
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+
+	// Required bufferOffset alignment of a buffer to image copy: a multiple of the texel or block size,
+	// and of 4 on queues without graphics or compute support, i.e. lcm(size, 4)
+	inline VkDeviceSize getCopyAlignment(VkFormat format) {
+		VkDeviceSize size = getFormatBlockInfo(format).size;
+		if (size % 4 == 0) {
+			return size;
+		}
+		return size % 2 == 0 ? size * 2 : size * 4;
+	}
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Bytes of one row of texel blocks, partial blocks at the edge count as whole blocks
+	inline VkDeviceSize getRowPitch(uint32_t width, VkFormat format) {
+		FormatBlockInfo info = getFormatBlockInfo(format);
+		VkDeviceSize blocksX = (static_cast<VkDeviceSize>(width) + info.width - 1) / info.width;
+		return blocksX * info.size;
+	}
+
+	inline VkDeviceSize getImageByteSize(uint32_t width, uint32_t height, VkFormat format) {
+		FormatBlockInfo info = getFormatBlockInfo(format);
+		VkDeviceSize blocksY = (static_cast<VkDeviceSize>(height) + info.height - 1) / info.height;
+		return getRowPitch(width, format) * blocksY;
+	}
+
+	// Number of levels of a full mip chain down to 1x1
+	inline uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+		uint32_t levels = 1;
+		uint32_t size = width > height ? width : height;
+		while (size > 1) {
+			size >>= 1;
+			levels++;
+		}
+		return levels;
+	}
+
+	inline uint32_t getMipDimension(uint32_t size, uint32_t level) {
+		uint32_t result = size >> level;
+		return result > 0 ? result : 1;
+	}
+
+	inline VkDeviceSize getMipLevelSize(uint32_t width, uint32_t height, VkFormat format, uint32_t level) {
+		return getImageByteSize(getMipDimension(width, level), getMipDimension(height, level), format);
+	}
+
+	// Byte offset of a level when all levels are packed back to back, starting with level 0
+	inline VkDeviceSize getMipLevelOffset(uint32_t width, uint32_t height, VkFormat format, uint32_t level) {
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < level; i++) {
+			offset += getMipLevelSize(width, height, format, i);
+		}
+		return offset;
+	}
+
+	// Byte offset of a level in staging memory, every level starts at a multiple of getCopyAlignment
+	inline VkDeviceSize getStagingLevelOffset(uint32_t width, uint32_t height, VkFormat format, uint32_t level) {
+		VkDeviceSize alignment = getCopyAlignment(format);
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < level; i++) {
+			offset += alignUp(getMipLevelSize(width, height, format, i), alignment);
+		}
+		return offset;
+	}
+
+	// Copies levels packed back to back into staging memory laid out by getStagingLevelOffset
+	inline void packStagingLevels(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, VkFormat format, uint32_t levelCount) {
+		VkDeviceSize alignment = getCopyAlignment(format);
+		VkDeviceSize dstOffset = 0;
+		VkDeviceSize srcOffset = 0;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			VkDeviceSize levelSize = getMipLevelSize(width, height, format, level);
+			memcpy(dst + dstOffset, src + srcOffset, static_cast<size_t>(levelSize));
+			dstOffset += alignUp(levelSize, alignment);
+			srcOffset += levelSize;
+		}
+	}
+
+	// pixels holds mipLevels levels packed back to back, level 0 first.
+	// Block-compressed levels are stored as whole blocks, e.g. a 2x2 BC1 level still takes 8 bytes.
 	struct ImageData {
 		std::vector<uint8_t> pixels;
 		uint32_t width = 0;
 		uint32_t height = 0;
 		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mipLevels = 1;
 
 		VkDeviceSize getImageSize() const {
-			VkDeviceSize vkWidth = static_cast<VkDeviceSize>(width);
-			VkDeviceSize vkHeight = static_cast<VkDeviceSize>(height);
-			uint32_t bytesPerPixel = getBytesPerPixel(format);
-			return vkWidth * vkHeight * bytesPerPixel;
+			return getImageByteSize(width, height, format);
+		}
+
+		VkDeviceSize getMipSize(uint32_t level) const {
+			return getMipLevelSize(width, height, format, level);
+		}
+
+		VkDeviceSize getMipOffset(uint32_t level) const {
+			return getMipLevelOffset(width, height, format, level);
+		}
+
+		// Size of all levels in bytes
+		VkDeviceSize getTotalSize() const {
+			return getMipLevelOffset(width, height, format, mipLevels);
 		}
 	};
 
@@ -105,19 +332,33 @@ namespace LibGFX {
 		VkFormat format = VK_FORMAT_UNDEFINED;
 		uint32_t width = 0;
 		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		MemoryAllocation allocation = {};
 	};
 
+	// Every face holds mipLevels levels packed back to back, level 0 first
 	struct CubemapData {
 		std::array<std::vector<uint8_t>, 6> pixels;
 		uint32_t width = 0;
 		uint32_t height = 0;
 		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mipLevels = 1;
 
 		VkDeviceSize getImageSize() const {
-			VkDeviceSize vkWidth = static_cast<VkDeviceSize>(width);
-			VkDeviceSize vkHeight = static_cast<VkDeviceSize>(height);
-			uint32_t bytesPerPixel = getBytesPerPixel(format);
-			return vkWidth * vkHeight * bytesPerPixel;
+			return getImageByteSize(width, height, format);
+		}
+
+		VkDeviceSize getMipSize(uint32_t level) const {
+			return getMipLevelSize(width, height, format, level);
+		}
+
+		VkDeviceSize getMipOffset(uint32_t level) const {
+			return getMipLevelOffset(width, height, format, level);
+		}
+
+		// Size of all levels of one face
+		VkDeviceSize getFaceSize() const {
+			return getMipLevelOffset(width, height, format, mipLevels);
 		}
 	};
 
@@ -128,5 +369,7 @@ namespace LibGFX {
 		VkFormat format = VK_FORMAT_UNDEFINED;
 		uint32_t width = 0;
 		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		MemoryAllocation allocation = {};
 	};
 }
\ No newline at end of file
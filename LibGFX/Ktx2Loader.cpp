@@ -0,0 +1,130 @@
+#include "Ktx2Loader.h"
+#include "LibGFX.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	// Identifier, header and the index of the data format, key/value and supercompression data
+	const size_t KTX2_LEVEL_INDEX_OFFSET = 12 + 9 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+}
+
+LibGFX::ImageData LibGFX::Ktx2Loader::loadImage(const std::string& filename)
+{
+	return parseImage(GFX::readFile(filename));
+}
+
+LibGFX::CubemapData LibGFX::Ktx2Loader::loadCubemap(const std::string& filename)
+{
+	return parseCubemap(GFX::readFile(filename));
+}
+
+bool LibGFX::Ktx2Loader::isKtx2(const std::vector<char>& data)
+{
+	return data.size() >= sizeof(KTX2_IDENTIFIER) && memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+LibGFX::ImageData LibGFX::Ktx2Loader::parseImage(const std::vector<char>& data)
+{
+	std::vector<LevelIndex> levels;
+	Header header = readHeader(data, levels);
+	if (header.faceCount != 1) {
+		throw std::runtime_error("KTX2: file holds a cubemap, use parseCubemap");
+	}
+
+	ImageData imageData = {};
+	imageData.width = header.pixelWidth;
+	imageData.height = header.pixelHeight;
+	imageData.format = static_cast<VkFormat>(header.vkFormat);
+	imageData.mipLevels = static_cast<uint32_t>(levels.size());
+	copyFace(data, header, levels, 0, imageData.pixels);
+	return imageData;
+}
+
+LibGFX::CubemapData LibGFX::Ktx2Loader::parseCubemap(const std::vector<char>& data)
+{
+	std::vector<LevelIndex> levels;
+	Header header = readHeader(data, levels);
+	if (header.faceCount != 6) {
+		throw std::runtime_error("KTX2: file does not hold a cubemap");
+	}
+
+	CubemapData cubemapData = {};
+	cubemapData.width = header.pixelWidth;
+	cubemapData.height = header.pixelHeight;
+	cubemapData.format = static_cast<VkFormat>(header.vkFormat);
+	cubemapData.mipLevels = static_cast<uint32_t>(levels.size());
+	for (uint32_t face = 0; face < 6; face++) {
+		copyFace(data, header, levels, face, cubemapData.pixels[face]);
+	}
+	return cubemapData;
+}
+
+LibGFX::Ktx2Loader::Header LibGFX::Ktx2Loader::readHeader(const std::vector<char>& data, std::vector<LevelIndex>& levels)
+{
+	if (!isKtx2(data) || data.size() < KTX2_LEVEL_INDEX_OFFSET) {
+		throw std::runtime_error("KTX2: invalid file identifier");
+	}
+
+	// All fields are little endian
+	Header header = {};
+	memcpy(&header, data.data() + sizeof(KTX2_IDENTIFIER), sizeof(Header));
+	if (header.vkFormat == VK_FORMAT_UNDEFINED) {
+		throw std::runtime_error("KTX2: Basis Universal textures must be transcoded before loading");
+	}
+	if (!isFormatSizeKnown(static_cast<VkFormat>(header.vkFormat))) {
+		throw std::runtime_error("KTX2: unsupported format " + std::to_string(header.vkFormat));
+	}
+	if (header.supercompressionScheme != 0) {
+		throw std::runtime_error("KTX2: supercompressed files are not supported");
+	}
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1) {
+		throw std::runtime_error("KTX2: only 2D textures are supported");
+	}
+	if (header.layerCount > 1) {
+		throw std::runtime_error("KTX2: texture arrays are not supported");
+	}
+	if (header.faceCount != 1 && header.faceCount != 6) {
+		throw std::runtime_error("KTX2: invalid face count");
+	}
+
+	// A level count of 0 asks the loader to generate the chain, the file only holds level 0
+	uint32_t levelCount = header.levelCount > 0 ? header.levelCount : 1;
+	if (levelCount > getMipLevelCount(header.pixelWidth, header.pixelHeight)) {
+		throw std::runtime_error("KTX2: invalid level count");
+	}
+	if (data.size() < KTX2_LEVEL_INDEX_OFFSET + levelCount * sizeof(LevelIndex)) {
+		throw std::runtime_error("KTX2: truncated level index");
+	}
+
+	levels.resize(levelCount);
+	memcpy(levels.data(), data.data() + KTX2_LEVEL_INDEX_OFFSET, levelCount * sizeof(LevelIndex));
+
+	// Without supercompression every level is exactly its faces packed back to back
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	for (uint32_t level = 0; level < levelCount; level++) {
+		VkDeviceSize faceSize = getMipLevelSize(header.pixelWidth, header.pixelHeight, format, level);
+		const LevelIndex& index = levels[level];
+		if (faceSize == 0 || index.byteLength != faceSize * header.faceCount) {
+			throw std::runtime_error("KTX2: level size does not match the format");
+		}
+		if (index.byteOffset > data.size() || index.byteLength > data.size() - index.byteOffset) {
+			throw std::runtime_error("KTX2: level data out of bounds");
+		}
+	}
+	return header;
+}
+
+void LibGFX::Ktx2Loader::copyFace(const std::vector<char>& data, const Header& header, const std::vector<LevelIndex>& levels, uint32_t face, std::vector<uint8_t>& pixels)
+{
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	pixels.resize(static_cast<size_t>(getMipLevelOffset(header.pixelWidth, header.pixelHeight, format, static_cast<uint32_t>(levels.size()))));
+
+	size_t dstOffset = 0;
+	for (uint32_t level = 0; level < levels.size(); level++) {
+		size_t faceSize = static_cast<size_t>(getMipLevelSize(header.pixelWidth, header.pixelHeight, format, level));
+		size_t srcOffset = static_cast<size_t>(levels[level].byteOffset) + faceSize * face;
+		memcpy(pixels.data() + dstOffset, data.data() + srcOffset, faceSize);
+		dstOffset += faceSize;
+	}
+}
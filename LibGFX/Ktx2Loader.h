@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include "Imaging.h"
+
+namespace LibGFX {
+
+	// Reader for KTX2 containers holding 2D textures or cubemaps with their mip chain in the vkFormat
+	// of the file (BC, ETC2, ASTC or uncompressed). Supercompressed files (BasisLZ, Zstandard),
+	// texture arrays and 3D textures are rejected.
+	class Ktx2Loader
+	{
+	public:
+		static ImageData loadImage(const std::string& filename);
+		static CubemapData loadCubemap(const std::string& filename);
+		static ImageData parseImage(const std::vector<char>& data);
+		static CubemapData parseCubemap(const std::vector<char>& data);
+		static bool isKtx2(const std::vector<char>& data);
+	private:
+		struct Header {
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+		};
+
+		struct LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		// Header and level index of a validated file, levels sorted from level 0 (largest) down
+		static Header readHeader(const std::vector<char>& data, std::vector<LevelIndex>& levels);
+		// Appends the given face of every level to pixels
+		static void copyFace(const std::vector<char>& data, const Header& header, const std::vector<LevelIndex>& levels, uint32_t face, std::vector<uint8_t>& pixels);
+	};
+}
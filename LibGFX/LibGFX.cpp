@@ -7,11 +7,11 @@
 using namespace std;
 using namespace LibGFX;
 
-GLFWwindow* GFX::createWindow(int width, int height, const char* title)
+GLFWwindow* GFX::createWindow(int width, int height, const char* title, bool resizable /*= false*/)
 {
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
 
 	auto window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 	return window;
@@ -8,11 +8,14 @@
 namespace LibGFX {
 	class GFX {
 	public:
-		static GLFWwindow* createWindow(int width, int height, const char* title);
+		static GLFWwindow* createWindow(int width, int height, const char* title, bool resizable = false);
 		static std::vector<char> readFile(const std::string& filename);
 		static std::unique_ptr<VkContext> createContext(GLFWwindow* targetWindow) {
 			return std::make_unique<VkContext>(targetWindow);
 		}
+		static std::unique_ptr<VkContext> createHeadlessContext() {
+			return std::make_unique<VkContext>(nullptr);
+		}
 	};
 }
 
@@ -0,0 +1,23 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+namespace LibGFX {
+
+	// Forward declaration of the allocator owned block a sub-allocation lives in
+	struct MemoryBlock;
+
+	// Handle to a range of device memory handed out by the MemoryAllocator
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		uint32_t order = 0;
+		MemoryBlock* block = nullptr; // nullptr for dedicated allocations
+		void* mappedData = nullptr; // Persistent mapping of host visible memory at offset
+
+		bool isDedicated() const {
+			return block == nullptr;
+		}
+	};
+}
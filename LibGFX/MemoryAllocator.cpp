@@ -0,0 +1,402 @@
+#include "MemoryAllocator.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+void LibGFX::MemoryAllocator::initialize(VkPhysicalDevice physicalDevice, VkDevice device, bool bufferDeviceAddress /*= false*/)
+{
+	m_device = device;
+	m_bufferDeviceAddress = bufferDeviceAddress;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+	// Nodes are aligned to at least MIN_NODE_SIZE, so a smaller granularity can never be violated
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	m_separateLinearPools = deviceProperties.limits.bufferImageGranularity > MIN_NODE_SIZE;
+	m_nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+	uint32_t memoryTypeCount = m_memoryProperties.memoryTypeCount;
+	m_pools.clear();
+	m_pools.resize(memoryTypeCount * 2);
+	m_dedicatedCounts.assign(memoryTypeCount, 0);
+	m_dedicatedBytes.assign(memoryTypeCount, 0);
+
+	for (uint32_t i = 0; i < memoryTypeCount; i++) {
+		// Small heaps (integrated GPUs, BAR memory) get blocks of an eighth of the heap
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = std::min(MAX_BLOCK_SIZE, std::bit_floor(heapSize / 8));
+		blockSize = std::max(blockSize, MIN_NODE_SIZE);
+
+		m_pools[i * 2].blockSize = blockSize;
+		m_pools[i * 2 + 1].blockSize = blockSize;
+	}
+}
+
+void LibGFX::MemoryAllocator::dispose()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& pool : m_pools) {
+		for (auto& block : pool.blocks) {
+			if (block->mappedData != nullptr) {
+				vkUnmapMemory(m_device, block->memory);
+			}
+			vkFreeMemory(m_device, block->memory, nullptr);
+		}
+		pool.blocks.clear();
+	}
+	m_pools.clear();
+	m_device = VK_NULL_HANDLE;
+}
+
+LibGFX::MemoryAllocation LibGFX::MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, VkMemoryPropertyFlags preferredProperties /*= 0*/)
+{
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties, preferredProperties);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Lazily allocated memory is only committed on demand, sharing a block would defeat that
+	if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+		return allocateDedicated(requirements.size, memoryTypeIndex);
+	}
+
+	uint32_t poolIndex = getPoolIndex(memoryTypeIndex, linear);
+	MemoryPool& pool = m_pools[poolIndex];
+
+	// Buddy nodes are aligned to their own size, so rounding up to the alignment satisfies it
+	VkDeviceSize nodeSize = std::bit_ceil(std::max({ requirements.size, requirements.alignment, MIN_NODE_SIZE }));
+	if (nodeSize > pool.blockSize / 2) {
+		return allocateDedicated(requirements.size, memoryTypeIndex);
+	}
+	uint32_t order = static_cast<uint32_t>(std::countr_zero(nodeSize / MIN_NODE_SIZE));
+
+	MemoryBlock* targetBlock = nullptr;
+	VkDeviceSize offset = 0;
+	for (auto& block : pool.blocks) {
+		if (allocateFromBlock(*block, order, offset)) {
+			targetBlock = block.get();
+			break;
+		}
+	}
+
+	if (targetBlock == nullptr) {
+		targetBlock = createBlock(poolIndex, memoryTypeIndex, nodeSize);
+		if (!allocateFromBlock(*targetBlock, order, offset)) {
+			throw std::runtime_error("Failed to sub-allocate from memory block");
+		}
+	}
+
+	targetBlock->allocationCount++;
+	targetBlock->usedBytes += nodeSize;
+	targetBlock->requestedBytes += requirements.size;
+
+	MemoryAllocation allocation = {};
+	allocation.memory = targetBlock->memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.order = order;
+	allocation.block = targetBlock;
+	if (targetBlock->mappedData != nullptr) {
+		allocation.mappedData = static_cast<uint8_t*>(targetBlock->mappedData) + offset;
+	}
+	return allocation;
+}
+
+void LibGFX::MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (allocation.isDedicated()) {
+		if (allocation.mappedData != nullptr) {
+			vkUnmapMemory(m_device, allocation.memory);
+		}
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+		m_dedicatedCounts[allocation.memoryTypeIndex]--;
+		m_dedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+		allocation = {};
+		return;
+	}
+
+	MemoryBlock* block = allocation.block;
+	freeToBlock(*block, allocation.offset, allocation.order);
+	block->allocationCount--;
+	block->usedBytes -= MIN_NODE_SIZE << allocation.order;
+	block->requestedBytes -= allocation.size;
+
+	// Keep a single empty block per pool around to avoid thrashing vkAllocateMemory
+	if (block->allocationCount == 0) {
+		MemoryPool& pool = m_pools[block->poolIndex];
+		for (auto& other : pool.blocks) {
+			if (other.get() != block && other->allocationCount == 0) {
+				destroyBlock(pool, block);
+				break;
+			}
+		}
+	}
+	allocation = {};
+}
+
+void LibGFX::MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isHostCoherent(allocation)) {
+		return;
+	}
+
+	VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+	if (vkFlushMappedMemoryRanges(m_device, 1, &range) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to flush mapped memory");
+	}
+}
+
+void LibGFX::MemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isHostCoherent(allocation)) {
+		return;
+	}
+
+	VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+	if (vkInvalidateMappedMemoryRanges(m_device, 1, &range) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to invalidate mapped memory");
+	}
+}
+
+bool LibGFX::MemoryAllocator::isHostCoherent(const MemoryAllocation& allocation) const
+{
+	return (m_memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+uint32_t LibGFX::MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("Failed to find suitable memory type");
+}
+
+uint32_t LibGFX::MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) const
+{
+	if (preferredProperties != 0) {
+		VkMemoryPropertyFlags combined = properties | preferredProperties;
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & combined) == combined) {
+				return i;
+			}
+		}
+	}
+	return findMemoryType(typeFilter, properties);
+}
+
+LibGFX::MemoryStats LibGFX::MemoryAllocator::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MemoryStats stats = {};
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		collectStats(i, stats);
+	}
+	return stats;
+}
+
+LibGFX::MemoryStats LibGFX::MemoryAllocator::getStats(uint32_t memoryTypeIndex) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MemoryStats stats = {};
+	collectStats(memoryTypeIndex, stats);
+	return stats;
+}
+
+uint32_t LibGFX::MemoryAllocator::getPoolIndex(uint32_t memoryTypeIndex, bool linear) const
+{
+	if (m_separateLinearPools && !linear) {
+		return memoryTypeIndex * 2 + 1;
+	}
+	return memoryTypeIndex * 2;
+}
+
+LibGFX::MemoryBlock* LibGFX::MemoryAllocator::createBlock(uint32_t poolIndex, uint32_t memoryTypeIndex, VkDeviceSize minSize)
+{
+	MemoryPool& pool = m_pools[poolIndex];
+	VkDeviceSize blockSize = pool.blockSize;
+
+	// Retry with smaller blocks when the heap is close to exhaustion
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	while (true) {
+		if (allocateMemory(blockSize, memoryTypeIndex, &memory) == VK_SUCCESS) {
+			break;
+		}
+		if (blockSize / 2 < minSize) {
+			throw std::runtime_error("Failed to allocate memory block");
+		}
+		blockSize /= 2;
+	}
+
+	auto block = std::make_unique<MemoryBlock>();
+	block->memory = memory;
+	block->size = blockSize;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->poolIndex = poolIndex;
+	block->mappedData = mapMemory(memory, memoryTypeIndex);
+	block->maxOrder = static_cast<uint32_t>(std::countr_zero(blockSize / MIN_NODE_SIZE));
+	block->freeLists.resize(block->maxOrder + 1);
+	block->freeLists[block->maxOrder].insert(0);
+
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+void LibGFX::MemoryAllocator::destroyBlock(MemoryPool& pool, MemoryBlock* block)
+{
+	if (block->mappedData != nullptr) {
+		vkUnmapMemory(m_device, block->memory);
+	}
+	vkFreeMemory(m_device, block->memory, nullptr);
+	auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const std::unique_ptr<MemoryBlock>& entry) {
+		return entry.get() == block;
+	});
+	if (it != pool.blocks.end()) {
+		pool.blocks.erase(it);
+	}
+}
+
+bool LibGFX::MemoryAllocator::allocateFromBlock(MemoryBlock& block, uint32_t order, VkDeviceSize& offset)
+{
+	// Find the smallest free node that fits
+	uint32_t freeOrder = order;
+	while (freeOrder <= block.maxOrder && block.freeLists[freeOrder].empty()) {
+		freeOrder++;
+	}
+	if (freeOrder > block.maxOrder) {
+		return false;
+	}
+
+	// Take the lowest offset to keep the block compact
+	auto& freeList = block.freeLists[freeOrder];
+	VkDeviceSize nodeOffset = *freeList.begin();
+	freeList.erase(freeList.begin());
+
+	// Split down to the requested order, the upper halves stay free
+	while (freeOrder > order) {
+		freeOrder--;
+		block.freeLists[freeOrder].insert(nodeOffset + (MIN_NODE_SIZE << freeOrder));
+	}
+
+	offset = nodeOffset;
+	return true;
+}
+
+void LibGFX::MemoryAllocator::freeToBlock(MemoryBlock& block, VkDeviceSize offset, uint32_t order)
+{
+	// Merge with the buddy node as long as it is free
+	while (order < block.maxOrder) {
+		VkDeviceSize buddyOffset = offset ^ (MIN_NODE_SIZE << order);
+		auto& freeList = block.freeLists[order];
+		auto it = freeList.find(buddyOffset);
+		if (it == freeList.end()) {
+			break;
+		}
+		freeList.erase(it);
+		offset = std::min(offset, buddyOffset);
+		order++;
+	}
+	block.freeLists[order].insert(offset);
+}
+
+LibGFX::MemoryAllocation LibGFX::MemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+	MemoryAllocation allocation = {};
+	if (allocateMemory(size, memoryTypeIndex, &allocation.memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate dedicated memory");
+	}
+	allocation.offset = 0;
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.block = nullptr;
+	allocation.mappedData = mapMemory(allocation.memory, memoryTypeIndex);
+
+	m_dedicatedCounts[memoryTypeIndex]++;
+	m_dedicatedBytes[memoryTypeIndex] += size;
+	return allocation;
+}
+
+VkResult LibGFX::MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory* memory) const
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	// Buffers created with SHADER_DEVICE_ADDRESS usage may be bound to any block
+	VkMemoryAllocateFlagsInfo flagsInfo = {};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	if (m_bufferDeviceAddress) {
+		allocInfo.pNext = &flagsInfo;
+	}
+
+	return vkAllocateMemory(m_device, &allocInfo, nullptr, memory);
+}
+
+void LibGFX::MemoryAllocator::collectStats(uint32_t memoryTypeIndex, MemoryStats& stats) const
+{
+	for (uint32_t poolIndex : { memoryTypeIndex * 2, memoryTypeIndex * 2 + 1 }) {
+		for (const auto& block : m_pools[poolIndex].blocks) {
+			stats.blockCount++;
+			stats.allocationCount += block->allocationCount;
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->usedBytes;
+			stats.requestedBytes += block->requestedBytes;
+			stats.freeBytes += block->size - block->usedBytes;
+
+			// The highest order with a free node is the largest contiguous free range
+			for (uint32_t order = block->maxOrder + 1; order-- > 0;) {
+				if (!block->freeLists[order].empty()) {
+					stats.largestFreeRange = std::max(stats.largestFreeRange, MIN_NODE_SIZE << order);
+					break;
+				}
+			}
+		}
+	}
+
+	stats.dedicatedAllocationCount += m_dedicatedCounts[memoryTypeIndex];
+	stats.allocationCount += m_dedicatedCounts[memoryTypeIndex];
+	stats.dedicatedBytes += m_dedicatedBytes[memoryTypeIndex];
+}
+
+void* LibGFX::MemoryAllocator::mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex)
+{
+	// Host visible memory is mapped once for its whole lifetime
+	if ((m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+		return nullptr;
+	}
+
+	void* mappedData = nullptr;
+	if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mappedData) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to map memory");
+	}
+	return mappedData;
+}
+
+VkMappedMemoryRange LibGFX::MemoryAllocator::getMappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+	// Ranges must be aligned to nonCoherentAtomSize, block nodes are always a multiple of it
+	VkDeviceSize start = allocation.offset + offset;
+	VkDeviceSize end = allocation.offset + offset + size;
+	VkDeviceSize alignedStart = start - (start % m_nonCoherentAtomSize);
+	VkDeviceSize alignedEnd = ((end + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize) * m_nonCoherentAtomSize;
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = alignedStart;
+	range.size = alignedEnd - alignedStart;
+
+	// Dedicated allocations are not padded, flush up to the end of the memory instead
+	if (allocation.isDedicated() && alignedEnd > allocation.size) {
+		range.size = VK_WHOLE_SIZE;
+	}
+	return range;
+}
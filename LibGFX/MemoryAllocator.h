@@ -0,0 +1,98 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include "MemoryAllocation.h"
+
+namespace LibGFX {
+
+	// Usage statistics for a single memory type or the whole allocator
+	struct MemoryStats {
+		uint32_t blockCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize blockBytes = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		VkDeviceSize freeBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+
+		// 0 when all free block memory is one range, approaching 1 when it is split into many small ranges
+		float getFragmentation() const {
+			if (freeBytes == 0) {
+				return 0.0f;
+			}
+			return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+		}
+	};
+
+	// A single VkDeviceMemory allocation that is split into power of two nodes (buddy system)
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		uint32_t poolIndex = 0;
+		uint32_t maxOrder = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		void* mappedData = nullptr;
+		std::vector<std::set<VkDeviceSize>> freeLists; // Free node offsets per order
+	};
+
+	// Block based sub-allocator for device memory. Every memory type owns a list of blocks,
+	// requests bigger than half a block get a dedicated allocation.
+	class MemoryAllocator
+	{
+	public:
+		static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+		static constexpr VkDeviceSize MAX_BLOCK_SIZE = 256ull * 1024 * 1024;
+
+		// bufferDeviceAddress allocates all memory with VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT, the feature must be enabled
+		void initialize(VkPhysicalDevice physicalDevice, VkDevice device, bool bufferDeviceAddress = false);
+		void dispose();
+
+		// The preferred properties are used when a matching memory type exists, e.g. LAZILY_ALLOCATED for transient attachments
+		MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, VkMemoryPropertyFlags preferredProperties = 0);
+		void free(MemoryAllocation& allocation);
+		void flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+		void invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+		bool isHostCoherent(const MemoryAllocation& allocation) const;
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) const;
+		MemoryStats getStats() const;
+		MemoryStats getStats(uint32_t memoryTypeIndex) const;
+
+	private:
+		// Linear and optimal resources get separate pools if bufferImageGranularity exceeds the node size
+		struct MemoryPool {
+			VkDeviceSize blockSize = 0;
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+		VkDeviceSize m_nonCoherentAtomSize = 1;
+		bool m_separateLinearPools = false;
+		bool m_bufferDeviceAddress = false;
+		std::vector<MemoryPool> m_pools;
+		std::vector<uint32_t> m_dedicatedCounts;
+		std::vector<VkDeviceSize> m_dedicatedBytes;
+		mutable std::mutex m_mutex;
+
+		uint32_t getPoolIndex(uint32_t memoryTypeIndex, bool linear) const;
+		MemoryBlock* createBlock(uint32_t poolIndex, uint32_t memoryTypeIndex, VkDeviceSize minSize);
+		void destroyBlock(MemoryPool& pool, MemoryBlock* block);
+		bool allocateFromBlock(MemoryBlock& block, uint32_t order, VkDeviceSize& offset);
+		void freeToBlock(MemoryBlock& block, VkDeviceSize offset, uint32_t order);
+		MemoryAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+		VkResult allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory* memory) const;
+		void collectStats(uint32_t memoryTypeIndex, MemoryStats& stats) const;
+		void* mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex);
+		VkMappedMemoryRange getMappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+	};
+}
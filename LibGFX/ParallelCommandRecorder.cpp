@@ -0,0 +1,130 @@
+#include "ParallelCommandRecorder.h"
+#include <stdexcept>
+
+void LibGFX::ParallelCommandRecorder::create(VkContext& context, uint32_t framesInFlight, uint32_t threadCount)
+{
+	if (framesInFlight == 0 || threadCount == 0) {
+		throw std::runtime_error("ParallelCommandRecorder: frame and thread count must not be zero");
+	}
+
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	m_framesInFlight = framesInFlight;
+	m_threadCount = threadCount;
+	m_currentFrame = 0;
+	m_pools.resize(static_cast<size_t>(framesInFlight) * threadCount);
+	for (auto& pool : m_pools) {
+		// Pools are reset as a whole, the buffers are never reset individually
+		pool.commandPool = context.createCommandPool(static_cast<uint32_t>(indices.graphicsFamily), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	}
+}
+
+void LibGFX::ParallelCommandRecorder::destroy(VkContext& context)
+{
+	for (auto& pool : m_pools) {
+		// Destroying the pool frees its command buffers
+		context.destroyCommandPool(pool.commandPool);
+	}
+	m_pools.clear();
+	m_executeList.clear();
+	m_threadCount = 0;
+	m_framesInFlight = 0;
+}
+
+void LibGFX::ParallelCommandRecorder::beginFrame(VkContext& context, uint32_t frameIndex)
+{
+	m_currentFrame = frameIndex;
+	for (uint32_t thread = 0; thread < m_threadCount; thread++) {
+		ThreadCommandPool& pool = getPool(frameIndex, thread);
+		if (pool.usedCount > 0) {
+			if (vkResetCommandPool(context.getDevice(), pool.commandPool, 0) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to reset thread command pool");
+			}
+		}
+		pool.usedCount = 0;
+		pool.recorded.clear();
+	}
+}
+
+VkCommandBuffer LibGFX::ParallelCommandRecorder::beginSecondary(VkContext& context, uint32_t threadIndex, const RenderPass& renderPass, uint32_t subpass, VkFramebuffer framebuffer /*= VK_NULL_HANDLE*/)
+{
+	// The framebuffer is optional but lets the driver optimize for the known attachments
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass.getRenderPass();
+	inheritanceInfo.subpass = subpass;
+	inheritanceInfo.framebuffer = framebuffer;
+	return beginSecondary(context, threadIndex, inheritanceInfo);
+}
+
+VkCommandBuffer LibGFX::ParallelCommandRecorder::beginSecondary(VkContext& context, uint32_t threadIndex, const RenderingFormats& renderingFormats)
+{
+	VkCommandBufferInheritanceRenderingInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	renderingInfo.viewMask = renderingFormats.viewMask;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(renderingFormats.colorFormats.size());
+	renderingInfo.pColorAttachmentFormats = renderingFormats.colorFormats.data();
+	renderingInfo.depthAttachmentFormat = renderingFormats.depthFormat;
+	renderingInfo.stencilAttachmentFormat = renderingFormats.stencilFormat;
+	renderingInfo.rasterizationSamples = renderingFormats.samples;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = &renderingInfo;
+	return beginSecondary(context, threadIndex, inheritanceInfo);
+}
+
+VkCommandBuffer LibGFX::ParallelCommandRecorder::beginSecondary(VkContext& context, uint32_t threadIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo)
+{
+	ThreadCommandPool& pool = getPool(m_currentFrame, threadIndex);
+	if (pool.usedCount == pool.commandBuffers.size()) {
+		pool.commandBuffers.push_back(context.allocateCommandBuffer(pool.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+	}
+	VkCommandBuffer commandBuffer = pool.commandBuffers[pool.usedCount++];
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin secondary command buffer");
+	}
+	return commandBuffer;
+}
+
+void LibGFX::ParallelCommandRecorder::endSecondary(VkContext& context, uint32_t threadIndex, VkCommandBuffer commandBuffer)
+{
+	context.endCommandBuffer(commandBuffer);
+	getPool(m_currentFrame, threadIndex).recorded.push_back(commandBuffer);
+}
+
+void LibGFX::ParallelCommandRecorder::executeCommands(VkCommandBuffer primaryCommandBuffer)
+{
+	// Executed buffers inherit this pass, a later pass in the same frame only gets its own
+	m_executeList.clear();
+	for (uint32_t thread = 0; thread < m_threadCount; thread++) {
+		ThreadCommandPool& pool = getPool(m_currentFrame, thread);
+		m_executeList.insert(m_executeList.end(), pool.recorded.begin(), pool.recorded.end());
+		pool.recorded.clear();
+	}
+
+	if (!m_executeList.empty()) {
+		vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(m_executeList.size()), m_executeList.data());
+	}
+}
+
+uint32_t LibGFX::ParallelCommandRecorder::getRecordedCount() const
+{
+	size_t count = 0;
+	for (uint32_t thread = 0; thread < m_threadCount; thread++) {
+		count += m_pools[static_cast<size_t>(m_currentFrame) * m_threadCount + thread].recorded.size();
+	}
+	return static_cast<uint32_t>(count);
+}
+
+LibGFX::ThreadCommandPool& LibGFX::ParallelCommandRecorder::getPool(uint32_t frameIndex, uint32_t threadIndex)
+{
+	if (frameIndex >= m_framesInFlight || threadIndex >= m_threadCount) {
+		throw std::runtime_error("ParallelCommandRecorder: frame or thread index out of range");
+	}
+	return m_pools[static_cast<size_t>(frameIndex) * m_threadCount + threadIndex];
+}
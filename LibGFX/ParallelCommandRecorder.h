@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Command pool owned by one worker thread for one frame in flight
+	struct ThreadCommandPool {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers;	// Secondary buffers, reused after the pool reset
+		std::vector<VkCommandBuffer> recorded;	// Buffers ended since the last executeCommands, in recording order
+		uint32_t usedCount = 0;
+	};
+
+	// Per thread, per frame command pools for recording secondary command buffers in parallel.
+	// Thread i only ever touches the pools of index i, so recording needs no locking.
+	// The primary begins the render pass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	// and calls executeCommands once all workers are done.
+	class ParallelCommandRecorder
+	{
+	public:
+		void create(VkContext& context, uint32_t framesInFlight, uint32_t threadCount);
+		void destroy(VkContext& context);
+
+		// Resets the pools of the frame, the frame fence must have signaled
+		void beginFrame(VkContext& context, uint32_t frameIndex);
+
+		// Begins a secondary command buffer that continues the given render pass, called from the worker thread
+		VkCommandBuffer beginSecondary(VkContext& context, uint32_t threadIndex, const RenderPass& renderPass, uint32_t subpass, VkFramebuffer framebuffer = VK_NULL_HANDLE);
+		// Dynamic rendering variant, the primary begins rendering with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+		VkCommandBuffer beginSecondary(VkContext& context, uint32_t threadIndex, const RenderingFormats& renderingFormats);
+		void endSecondary(VkContext& context, uint32_t threadIndex, VkCommandBuffer commandBuffer);
+
+		// Executes every buffer recorded since the previous call, ordered by thread index and then recording order.
+		// Call once per render pass, after the workers of that pass are done.
+		void executeCommands(VkCommandBuffer primaryCommandBuffer);
+		uint32_t getRecordedCount() const;
+
+		uint32_t getThreadCount() const { return m_threadCount; }
+		uint32_t getFramesInFlight() const { return m_framesInFlight; }
+	private:
+		std::vector<ThreadCommandPool> m_pools;	// framesInFlight * threadCount, grouped by frame
+		std::vector<VkCommandBuffer> m_executeList;
+		uint32_t m_threadCount = 0;
+		uint32_t m_framesInFlight = 0;
+		uint32_t m_currentFrame = 0;
+
+		ThreadCommandPool& getPool(uint32_t frameIndex, uint32_t threadIndex);
+		VkCommandBuffer beginSecondary(VkContext& context, uint32_t threadIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo);
+	};
+}
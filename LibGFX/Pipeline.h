@@ -6,7 +6,8 @@ namespace LibGFX {
 	// Forward declaration of VkContext to avoid circular dependency
 	class VkContext;
 
-	// Abstract base class for a graphics pipeline
+	// Abstract base class for a graphics or compute pipeline.
+	// Implementations should create through VkContext::createGraphicsPipeline / createComputePipeline so the pipeline cache is used.
 	class Pipeline {
 
 	public:
@@ -0,0 +1,24 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+namespace LibGFX {
+
+	// Pipeline creation counters of a VkContext. Hits and misses need VK_EXT_pipeline_creation_feedback,
+	// without it pipelines are counted as unknown and only the timing is recorded.
+	struct PipelineCacheStats {
+		bool loadedFromDisk = false;
+		size_t loadedBytes = 0;
+		uint32_t pipelineCount = 0;
+		uint32_t cacheHits = 0;
+		uint32_t cacheMisses = 0;
+		uint32_t unknownCount = 0;
+		double totalCreateMs = 0.0;
+		double hitCreateMs = 0.0;
+		double missCreateMs = 0.0;
+
+		double getHitRate() const {
+			uint32_t known = cacheHits + cacheMisses;
+			return known > 0 ? static_cast<double>(cacheHits) / static_cast<double>(known) : 0.0;
+		}
+	};
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+namespace LibGFX {
+
+	// Trade off between latency, tearing and throughput when creating a swapchain.
+	// Every policy falls back to FIFO, which is always available.
+	enum class PresentPolicy {
+		LowestLatency,	// IMMEDIATE > MAILBOX > FIFO_RELAXED > FIFO, fewest images
+		LowLatencyNoTearing,	// MAILBOX > FIFO, one image above the minimum
+		MaxThroughput,	// MAILBOX > FIFO, two images above the minimum so the CPU never waits for an image
+		Vsync	// FIFO, one image above the minimum
+	};
+}
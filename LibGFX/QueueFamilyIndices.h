@@ -1,8 +1,13 @@
 #pragma once
+#include <cstdint>
 namespace LibGFX {
 	struct QueueFamilyIndices {
 		int graphicsFamily = -1;
 		int presentFamily = -1;
+		int transferFamily = -1; // Falls back to the graphics family if there is no separate one
+		int computeFamily = -1; // Falls back to the graphics family if there is no separate one
+		uint32_t transferQueueIndex = 0;
+		uint32_t computeQueueIndex = 0; // Second queue when compute shares a non graphics family with transfer
 
 		bool isValid() {
 			return graphicsFamily >= 0 && presentFamily >= 0;
@@ -11,5 +16,13 @@ namespace LibGFX {
 		bool gpShared() {
 			return graphicsFamily == presentFamily;
 		}
+
+		bool hasDedicatedTransfer() const {
+			return transferFamily >= 0 && transferFamily != graphicsFamily;
+		}
+
+		bool hasDedicatedCompute() const {
+			return computeFamily >= 0 && computeFamily != graphicsFamily;
+		}
 	};
-}
\ No newline at end of file
+}
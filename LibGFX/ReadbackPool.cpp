@@ -0,0 +1,322 @@
+#include "ReadbackPool.h"
+#include "Imaging.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void LibGFX::ReadbackPool::create(VkContext& context, uint32_t bufferCount /*= 3*/, VkDeviceSize bufferSize /*= 0*/)
+{
+	if (bufferCount == 0) {
+		throw std::runtime_error("ReadbackPool: bufferCount must be at least 1");
+	}
+
+	// Internal command buffers are re-recorded once their slot is free again
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	m_commandPool = context.createCommandPool(static_cast<uint32_t>(indices.graphicsFamily), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	m_bufferSize = bufferSize;
+	m_nextTicketId = 1;
+
+	m_slots.resize(bufferCount);
+	for (Slot& slot : m_slots) {
+		slot.internalFence = context.createFence();
+		if (bufferSize > 0) {
+			slot.buffer = context.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		}
+	}
+}
+
+void LibGFX::ReadbackPool::destroy(VkContext& context)
+{
+	// Pending copies still write into the buffers
+	for (Slot& slot : m_slots) {
+		if (slot.state == SlotState::Pending) {
+			context.waitForFence(slot.fence);
+		}
+	}
+
+	for (Slot& slot : m_slots) {
+		if (slot.buffer.buffer != VK_NULL_HANDLE) {
+			context.destroyBuffer(slot.buffer);
+		}
+		if (slot.commandBuffer != VK_NULL_HANDLE) {
+			context.freeCommandBuffer(m_commandPool, slot.commandBuffer);
+		}
+		context.destroyFence(slot.internalFence);
+	}
+	m_slots.clear();
+
+	if (m_commandPool != VK_NULL_HANDLE) {
+		context.destroyCommandPool(m_commandPool);
+	}
+	m_bufferSize = 0;
+}
+
+LibGFX::ReadbackTicket LibGFX::ReadbackPool::readbackImage(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, VkFormat format, uint32_t layer /*= 0*/)
+{
+	checkSubmitFence(context, submitFence);
+	Slot* slot = acquireSlot(context, getImageByteSize(width, height, format));
+	if (slot == nullptr) {
+		return {};
+	}
+
+	recordImageCopy(context, commandBuffer, *slot, image, imageLayout, width, height, layer);
+	slot->fence = submitFence;
+	return { slot->ticketId };
+}
+
+LibGFX::ReadbackTicket LibGFX::ReadbackPool::readbackBuffer(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, const Buffer& buffer, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/)
+{
+	checkSubmitFence(context, submitFence);
+	if (size == VK_WHOLE_SIZE) {
+		size = buffer.size - offset;
+	}
+
+	Slot* slot = acquireSlot(context, size);
+	if (slot == nullptr) {
+		return {};
+	}
+
+	recordBufferCopy(commandBuffer, *slot, buffer, offset);
+	slot->fence = submitFence;
+	return { slot->ticketId };
+}
+
+LibGFX::ReadbackTicket LibGFX::ReadbackPool::readbackSwapchainImage(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, const SwapchainInfo& swapchainInfo, uint32_t imageIndex, VkImageLayout imageLayout)
+{
+	if (!(swapchainInfo.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+		throw std::runtime_error("ReadbackPool: swapchain images do not support TRANSFER_SRC usage on this surface");
+	}
+	return readbackImage(context, commandBuffer, submitFence, swapchainInfo.images.at(imageIndex), imageLayout, swapchainInfo.extent.width, swapchainInfo.extent.height, swapchainInfo.surfaceFormat.format);
+}
+
+LibGFX::ReadbackTicket LibGFX::ReadbackPool::readbackImage(VkContext& context, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, VkFormat format, uint32_t layer /*= 0*/)
+{
+	Slot* slot = acquireSlot(context, getImageByteSize(width, height, format));
+	if (slot == nullptr) {
+		return {};
+	}
+
+	VkCommandBuffer commandBuffer = beginInternal(context, *slot);
+	recordImageCopy(context, commandBuffer, *slot, image, imageLayout, width, height, layer);
+	submitInternal(context, *slot);
+	return { slot->ticketId };
+}
+
+LibGFX::ReadbackTicket LibGFX::ReadbackPool::readbackBuffer(VkContext& context, const Buffer& buffer, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/)
+{
+	if (size == VK_WHOLE_SIZE) {
+		size = buffer.size - offset;
+	}
+
+	Slot* slot = acquireSlot(context, size);
+	if (slot == nullptr) {
+		return {};
+	}
+
+	VkCommandBuffer commandBuffer = beginInternal(context, *slot);
+	recordBufferCopy(commandBuffer, *slot, buffer, offset);
+	submitInternal(context, *slot);
+	return { slot->ticketId };
+}
+
+bool LibGFX::ReadbackPool::isComplete(VkContext& context, ReadbackTicket ticket)
+{
+	Slot* slot = findSlot(ticket);
+	if (slot == nullptr) {
+		return false;
+	}
+
+	// Remember the result, the caller's fence may be reset and reused for a later frame
+	if (slot->state == SlotState::Pending && vkGetFenceStatus(context.getDevice(), slot->fence) == VK_SUCCESS) {
+		slot->state = SlotState::Complete;
+	}
+	return slot->state == SlotState::Complete;
+}
+
+const void* LibGFX::ReadbackPool::map(VkContext& context, ReadbackTicket ticket, VkDeviceSize* size /*= nullptr*/)
+{
+	if (!isComplete(context, ticket)) {
+		return nullptr;
+	}
+
+	// No-op on coherent memory, HOST_CACHED types are often not coherent
+	Slot* slot = findSlot(ticket);
+	context.invalidateBuffer(slot->buffer, VK_WHOLE_SIZE, 0);
+	if (size != nullptr) {
+		*size = slot->size;
+	}
+	return slot->buffer.mapped;
+}
+
+bool LibGFX::ReadbackPool::read(VkContext& context, ReadbackTicket ticket, std::vector<uint8_t>& data)
+{
+	VkDeviceSize size = 0;
+	const void* mapped = map(context, ticket, &size);
+	if (mapped == nullptr) {
+		return false;
+	}
+
+	data.resize(static_cast<size_t>(size));
+	memcpy(data.data(), mapped, static_cast<size_t>(size));
+	release(context, ticket);
+	return true;
+}
+
+void LibGFX::ReadbackPool::release(VkContext& context, ReadbackTicket ticket)
+{
+	Slot* slot = findSlot(ticket);
+	if (slot == nullptr) {
+		return;
+	}
+
+	// A ticket dropped before completion keeps its buffer until acquireSlot sees the copy is done
+	slot->ticketId = 0;
+	if (slot->state != SlotState::Pending) {
+		slot->state = SlotState::Free;
+		slot->fence = VK_NULL_HANDLE;
+	}
+}
+
+uint32_t LibGFX::ReadbackPool::getFreeBufferCount() const
+{
+	uint32_t count = 0;
+	for (const Slot& slot : m_slots) {
+		if (slot.state == SlotState::Free) {
+			count++;
+		}
+	}
+	return count;
+}
+
+LibGFX::ReadbackPool::Slot* LibGFX::ReadbackPool::acquireSlot(VkContext& context, VkDeviceSize size)
+{
+	// Prefer a free slot that is already big enough, otherwise grow the first free one
+	Slot* freeSlot = nullptr;
+	for (Slot& slot : m_slots) {
+		if (slot.state == SlotState::Pending && slot.ticketId == 0 && vkGetFenceStatus(context.getDevice(), slot.fence) == VK_SUCCESS) {
+			slot.state = SlotState::Free;
+			slot.fence = VK_NULL_HANDLE;
+		}
+		if (slot.state != SlotState::Free) {
+			continue;
+		}
+		if (slot.buffer.buffer != VK_NULL_HANDLE && slot.buffer.size >= size) {
+			freeSlot = &slot;
+			break;
+		}
+		if (freeSlot == nullptr) {
+			freeSlot = &slot;
+		}
+	}
+
+	if (freeSlot == nullptr) {
+		return nullptr;
+	}
+
+	if (freeSlot->buffer.buffer == VK_NULL_HANDLE || freeSlot->buffer.size < size) {
+		if (freeSlot->buffer.buffer != VK_NULL_HANDLE) {
+			context.destroyBuffer(freeSlot->buffer);
+		}
+		freeSlot->buffer = context.createBuffer(std::max(size, m_bufferSize), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+	}
+
+	freeSlot->state = SlotState::Pending;
+	freeSlot->ticketId = m_nextTicketId++;
+	freeSlot->size = size;
+	return freeSlot;
+}
+
+void LibGFX::ReadbackPool::checkSubmitFence(VkContext& context, VkFence submitFence)
+{
+	// Completion is read from the fence, one still signaled from earlier work would resolve the ticket before the copy
+	if (vkGetFenceStatus(context.getDevice(), submitFence) != VK_NOT_READY) {
+		throw std::runtime_error("ReadbackPool: submitFence must be unsignaled when the readback is recorded");
+	}
+}
+
+LibGFX::ReadbackPool::Slot* LibGFX::ReadbackPool::findSlot(ReadbackTicket ticket)
+{
+	if (!ticket.isValid()) {
+		return nullptr;
+	}
+
+	for (Slot& slot : m_slots) {
+		if (slot.ticketId == ticket.id) {
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+void LibGFX::ReadbackPool::recordImageCopy(VkContext& context, VkCommandBuffer commandBuffer, Slot& slot, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, uint32_t layer)
+{
+	if (imageLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		context.recordImageLayoutTransition(commandBuffer, image, imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, 1, layer);
+	}
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = layer;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &region);
+
+	if (imageLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		context.recordImageLayoutTransition(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageLayout, 1, 1, layer);
+	}
+	recordHostBarrier(commandBuffer, slot);
+}
+
+void LibGFX::ReadbackPool::recordBufferCopy(VkCommandBuffer commandBuffer, Slot& slot, const Buffer& buffer, VkDeviceSize offset)
+{
+	VkBufferCopy region = {};
+	region.srcOffset = offset;
+	region.dstOffset = 0;
+	region.size = slot.size;
+	vkCmdCopyBuffer(commandBuffer, buffer.buffer, slot.buffer.buffer, 1, &region);
+	recordHostBarrier(commandBuffer, slot);
+}
+
+void LibGFX::ReadbackPool::recordHostBarrier(VkCommandBuffer commandBuffer, const Slot& slot)
+{
+	// Makes the copy visible to the host once the fence has signaled
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = slot.buffer.buffer;
+	barrier.offset = 0;
+	barrier.size = slot.size;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+VkCommandBuffer LibGFX::ReadbackPool::beginInternal(VkContext& context, Slot& slot)
+{
+	if (slot.commandBuffer == VK_NULL_HANDLE) {
+		slot.commandBuffer = context.allocateCommandBuffer(m_commandPool);
+	}
+	context.beginCommandBuffer(slot.commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	return slot.commandBuffer;
+}
+
+void LibGFX::ReadbackPool::submitInternal(VkContext& context, Slot& slot)
+{
+	context.endCommandBuffer(slot.commandBuffer);
+
+	// The slot was free, so the previous submission of its fence has completed
+	context.resetFence(slot.internalFence);
+	slot.fence = slot.internalFence;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &slot.commandBuffer;
+	context.submitCommandBuffer(context.getGraphicsQueue(), submitInfo, slot.internalFence);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Handle of a pending readback, id 0 means no buffer was free and nothing was recorded
+	struct ReadbackTicket {
+		uint64_t id = 0;
+		bool isValid() const { return id != 0; }
+	};
+
+	// Copies images and buffers into a small pool of host visible, preferably HOST_CACHED buffers.
+	// Nothing ever waits: a readback is either recorded into the caller's command buffer and resolves
+	// with the fence that command buffer is submitted with, or submitted on the graphics queue with an
+	// internal fence. With all buffers pending the ticket is invalid and the caller retries next frame,
+	// so bufferCount should match the number of readbacks in flight, e.g. one per frame in flight.
+	class ReadbackPool
+	{
+	public:
+		void create(VkContext& context, uint32_t bufferCount = 3, VkDeviceSize bufferSize = 0);
+		void destroy(VkContext& context);
+
+		// Level 0 of one layer of a color image with TRANSFER_SRC usage in imageLayout, the image is returned to that layout.
+		// submitFence is the fence the caller submits the command buffer with, it must be unsignaled (reset) at this point.
+		ReadbackTicket readbackImage(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, VkFormat format, uint32_t layer = 0);
+		ReadbackTicket readbackBuffer(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, const Buffer& buffer, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		// Screenshot of an acquired swapchain image, throws if the surface did not allow TRANSFER_SRC usage
+		ReadbackTicket readbackSwapchainImage(VkContext& context, VkCommandBuffer commandBuffer, VkFence submitFence, const SwapchainInfo& swapchainInfo, uint32_t imageIndex, VkImageLayout imageLayout);
+		// Same as above on an internal command buffer, submitted to the graphics queue right away
+		ReadbackTicket readbackImage(VkContext& context, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, VkFormat format, uint32_t layer = 0);
+		ReadbackTicket readbackBuffer(VkContext& context, const Buffer& buffer, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		bool isComplete(VkContext& context, ReadbackTicket ticket);
+		// Host pointer to the invalidated data or nullptr while the copy is pending, valid until release
+		const void* map(VkContext& context, ReadbackTicket ticket, VkDeviceSize* size = nullptr);
+		// Copies the data out and releases the ticket, false while the copy is pending
+		bool read(VkContext& context, ReadbackTicket ticket, std::vector<uint8_t>& data);
+		// Also valid for pending tickets, the buffer is reused once the copy has finished
+		void release(VkContext& context, ReadbackTicket ticket);
+
+		uint32_t getFreeBufferCount() const;
+	private:
+		enum class SlotState {
+			Free,
+			Pending,
+			Complete
+		};
+
+		struct Slot {
+			Buffer buffer = {};
+			SlotState state = SlotState::Free;
+			uint64_t ticketId = 0;
+			VkDeviceSize size = 0;
+			VkFence fence = VK_NULL_HANDLE;	// Caller's fence or internalFence
+			VkFence internalFence = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;	// Internal command buffer, reused
+		};
+
+		std::vector<Slot> m_slots;
+		VkCommandPool m_commandPool = VK_NULL_HANDLE;
+		VkDeviceSize m_bufferSize = 0;
+		uint64_t m_nextTicketId = 1;
+
+		Slot* acquireSlot(VkContext& context, VkDeviceSize size);
+		Slot* findSlot(ReadbackTicket ticket);
+		static void checkSubmitFence(VkContext& context, VkFence submitFence);
+		void recordImageCopy(VkContext& context, VkCommandBuffer commandBuffer, Slot& slot, VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height, uint32_t layer);
+		void recordBufferCopy(VkCommandBuffer commandBuffer, Slot& slot, const Buffer& buffer, VkDeviceSize offset);
+		void recordHostBarrier(VkCommandBuffer commandBuffer, const Slot& slot);
+		VkCommandBuffer beginInternal(VkContext& context, Slot& slot);
+		void submitInternal(VkContext& context, Slot& slot);
+	};
+}
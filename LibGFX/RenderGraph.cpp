@@ -0,0 +1,768 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+	constexpr VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+LibGFX::RenderGraphPass::RenderGraphPass(const std::string& name, ExecuteCallback callback)
+	: m_name(name), m_callback(std::move(callback))
+{
+}
+
+LibGFX::RenderGraphPass& LibGFX::RenderGraphPass::read(RenderGraphResource resource, RenderGraphAccess access /*= RenderGraphAccess::Sampled*/)
+{
+	Access entry;
+	entry.resource = resource;
+	entry.access = access;
+	entry.write = false;
+	m_accesses.push_back(entry);
+	return *this;
+}
+
+LibGFX::RenderGraphPass& LibGFX::RenderGraphPass::write(RenderGraphResource resource, RenderGraphAccess access /*= RenderGraphAccess::ColorAttachment*/, VkAttachmentLoadOp loadOp /*= VK_ATTACHMENT_LOAD_OP_CLEAR*/, VkClearValue clearValue /*= {}*/)
+{
+	Access entry;
+	entry.resource = resource;
+	entry.access = access;
+	entry.write = true;
+	entry.loadOp = loadOp;
+	entry.clearValue = clearValue;
+	m_accesses.push_back(entry);
+	return *this;
+}
+
+LibGFX::RenderGraphPass& LibGFX::RenderGraphPass::setSideEffect()
+{
+	m_sideEffect = true;
+	return *this;
+}
+
+LibGFX::RenderGraphPass& LibGFX::RenderGraphPass::setManualRendering()
+{
+	m_manualRendering = true;
+	return *this;
+}
+
+LibGFX::RenderGraphResource LibGFX::RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	m_resources.push_back(resource);
+	m_compiled = false;
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+LibGFX::RenderGraphResource LibGFX::RenderGraph::importImage(const std::string& name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout, VkImageAspectFlags aspect /*= VK_IMAGE_ASPECT_COLOR_BIT*/)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc.width = extent.width;
+	resource.desc.height = extent.height;
+	resource.desc.format = format;
+	resource.desc.aspect = aspect;
+	resource.imported = true;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	m_resources.push_back(resource);
+	m_compiled = false;
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+LibGFX::RenderGraphPass& LibGFX::RenderGraph::addPass(const std::string& name, RenderGraphPass::ExecuteCallback callback)
+{
+	m_passes.emplace_back(name, std::move(callback));
+	m_compiled = false;
+	return m_passes.back();
+}
+
+void LibGFX::RenderGraph::compile(VkContext& context)
+{
+	// Validate the declarations before touching any GPU resources
+	for (auto& pass : m_passes) {
+		for (size_t i = 0; i < pass.m_accesses.size(); i++) {
+			const auto& access = pass.m_accesses[i];
+			for (size_t j = 0; j < i; j++) {
+				if (pass.m_accesses[j].resource == access.resource) {
+					throw std::runtime_error("RenderGraph: pass '" + pass.m_name + "' uses the same image twice");
+				}
+			}
+			if (access.resource >= m_resources.size()) {
+				throw std::runtime_error("RenderGraph: pass '" + pass.m_name + "' uses an unknown resource");
+			}
+			if (access.write != isWriteAccess(access.access)) {
+				throw std::runtime_error("RenderGraph: pass '" + pass.m_name + "' declares a read as write or a write as read");
+			}
+		}
+	}
+
+	releaseImages(context, true);
+	m_stats = RenderGraphStats();
+	m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+
+	sortPasses();
+	cullPasses();
+	validateReads();
+	computeLifetimes();
+
+	for (const auto& pass : m_passes) {
+		if (pass.m_alive && pass.m_hasAttachments && !pass.m_manualRendering && !context.supportsDynamicRendering()) {
+			throw std::runtime_error("RenderGraph: pass '" + pass.m_name + "' needs dynamic rendering, use setManualRendering with a RenderPass instead");
+		}
+	}
+
+	createTransientImages(context);
+
+	// First run collects the end state of every image, the second one emits the barriers.
+	// Aliased images wait for the last use of every image sharing their memory.
+	buildBarriers(false);
+	buildBarriers(true);
+	m_compiled = true;
+}
+
+void LibGFX::RenderGraph::setImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView)
+{
+	Resource& entry = m_resources.at(resource);
+	if (!entry.imported) {
+		throw std::runtime_error("RenderGraph: '" + entry.name + "' is not an imported image");
+	}
+	entry.image.image = image;
+	entry.image.imageView = imageView;
+}
+
+void LibGFX::RenderGraph::execute(VkContext& context, VkCommandBuffer commandBuffer)
+{
+	if (!m_compiled) {
+		throw std::runtime_error("RenderGraph: execute called before compile");
+	}
+
+	for (uint32_t passIndex : m_order) {
+		RenderGraphPass& pass = m_passes[passIndex];
+		if (!pass.m_alive) {
+			continue;
+		}
+
+		recordBarriers(commandBuffer, pass.m_barriers, pass.m_srcStageMask, pass.m_dstStageMask);
+
+		bool rendering = pass.m_hasAttachments && !pass.m_manualRendering;
+		if (rendering) {
+			m_colorScratch.clear();
+			RenderingAttachment depthAttachment;
+			bool hasDepth = false;
+			VkExtent2D extent = { 0, 0 };
+			for (auto& access : pass.m_accesses) {
+				if (!isAttachmentAccess(access.access)) {
+					continue;
+				}
+
+				RenderingAttachment attachment;
+				attachment.imageView = getImageView(access.resource);
+				attachment.imageLayout = getAccessState(access.access).layout;
+				attachment.loadOp = access.write ? access.loadOp : VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachment.storeOp = access.storeOp;
+				attachment.clearValue = access.clearValue;
+				attachment.format = m_resources[access.resource].desc.format;
+				extent = getExtent(access.resource);
+				if (access.access == RenderGraphAccess::ColorAttachment) {
+					m_colorScratch.push_back(attachment);
+				}
+				else {
+					depthAttachment = attachment;
+					hasDepth = true;
+				}
+			}
+			context.beginRendering(commandBuffer, extent, m_colorScratch, hasDepth ? &depthAttachment : nullptr);
+		}
+
+		if (pass.m_callback) {
+			pass.m_callback(commandBuffer, *this);
+		}
+
+		if (rendering) {
+			context.endRendering(commandBuffer);
+		}
+	}
+
+	// Hand imported images back in the layout their owner expects
+	recordBarriers(commandBuffer, m_finalBarriers, m_finalSrcStageMask, m_finalDstStageMask);
+}
+
+void LibGFX::RenderGraph::reset(VkContext& context)
+{
+	releaseImages(context, true);
+	m_passes.clear();
+	m_order.clear();
+	m_resources.clear();
+	m_finalBarriers.clear();
+	m_stats = RenderGraphStats();
+	m_compiled = false;
+}
+
+void LibGFX::RenderGraph::destroy(VkContext& context)
+{
+	releaseImages(context, false);
+	m_passes.clear();
+	m_order.clear();
+	m_resources.clear();
+	m_finalBarriers.clear();
+	m_compiled = false;
+}
+
+VkImage LibGFX::RenderGraph::getImage(RenderGraphResource resource) const
+{
+	return m_resources.at(resource).image.image;
+}
+
+VkImageView LibGFX::RenderGraph::getImageView(RenderGraphResource resource) const
+{
+	return m_resources.at(resource).image.imageView;
+}
+
+VkExtent2D LibGFX::RenderGraph::getExtent(RenderGraphResource resource) const
+{
+	const RenderGraphImageDesc& desc = m_resources.at(resource).desc;
+	return { desc.width, desc.height };
+}
+
+void LibGFX::RenderGraph::sortPasses()
+{
+	// A read depends on the last writer declared before it, or on the last writer of the image if it is
+	// declared before all of them (transient images only, imported ones already hold contents).
+	// LOAD_OP_LOAD attachments read the contents of the writer declared before them.
+	// Writers keep their declaration order and wait for the readers of the previous contents.
+	size_t passCount = m_passes.size();
+	std::vector<std::vector<uint32_t>> dependents(passCount);
+	std::vector<uint32_t> dependencyCount(passCount, 0);
+	auto addEdge = [&](uint32_t from, uint32_t to) {
+		dependents[from].push_back(to);
+		dependencyCount[to]++;
+	};
+
+	std::vector<uint32_t> finalWriter(m_resources.size(), ~0u);
+	for (uint32_t passIndex = 0; passIndex < passCount; passIndex++) {
+		for (const auto& access : m_passes[passIndex].m_accesses) {
+			if (access.write) {
+				finalWriter[access.resource] = passIndex;
+			}
+		}
+	}
+
+	std::vector<uint32_t> lastWriter(m_resources.size(), ~0u);
+	std::vector<std::vector<uint32_t>> readers(m_resources.size());
+	for (uint32_t passIndex = 0; passIndex < passCount; passIndex++) {
+		for (const auto& access : m_passes[passIndex].m_accesses) {
+			RenderGraphResource index = access.resource;
+			bool readsContents = !access.write || (isAttachmentAccess(access.access) && access.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD);
+			if (readsContents) {
+				if (lastWriter[index] != ~0u) {
+					addEdge(lastWriter[index], passIndex);
+				}
+				else if (!access.write && !m_resources[index].imported && finalWriter[index] != ~0u) {
+					addEdge(finalWriter[index], passIndex);
+					continue;
+				}
+				if (!access.write) {
+					readers[index].push_back(passIndex);
+				}
+			}
+			if (access.write) {
+				if (lastWriter[index] != ~0u && !readsContents) {
+					addEdge(lastWriter[index], passIndex);
+				}
+				for (uint32_t reader : readers[index]) {
+					addEdge(reader, passIndex);
+				}
+				readers[index].clear();
+				lastWriter[index] = passIndex;
+			}
+		}
+	}
+
+	// Kahn's algorithm, ties go to the pass declared first so independent passes keep their order
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	for (uint32_t passIndex = 0; passIndex < passCount; passIndex++) {
+		if (dependencyCount[passIndex] == 0) {
+			ready.push(passIndex);
+		}
+	}
+
+	m_order.clear();
+	m_order.reserve(passCount);
+	while (!ready.empty()) {
+		uint32_t passIndex = ready.top();
+		ready.pop();
+		m_order.push_back(passIndex);
+		for (uint32_t dependent : dependents[passIndex]) {
+			if (--dependencyCount[dependent] == 0) {
+				ready.push(dependent);
+			}
+		}
+	}
+
+	if (m_order.size() != passCount) {
+		for (uint32_t passIndex = 0; passIndex < passCount; passIndex++) {
+			if (dependencyCount[passIndex] != 0) {
+				throw std::runtime_error("RenderGraph: pass '" + m_passes[passIndex].m_name + "' is part of or waits on a dependency cycle");
+			}
+		}
+	}
+}
+
+void LibGFX::RenderGraph::cullPasses()
+{
+	// Walk backwards: a pass survives if something later consumes one of its writes.
+	// A write that does not keep the old contents satisfies the need, reads create new ones.
+	std::vector<bool> needed(m_resources.size(), false);
+	for (auto it = m_order.rbegin(); it != m_order.rend(); ++it) {
+		RenderGraphPass& pass = m_passes[*it];
+		pass.m_alive = pass.m_sideEffect;
+		pass.m_hasAttachments = false;
+		for (auto& access : pass.m_accesses) {
+			if (access.write && (needed[access.resource] || m_resources[access.resource].imported)) {
+				pass.m_alive = true;
+			}
+			if (isAttachmentAccess(access.access)) {
+				pass.m_hasAttachments = true;
+			}
+		}
+
+		if (!pass.m_alive) {
+			m_stats.culledPassCount++;
+			continue;
+		}
+
+		for (auto& access : pass.m_accesses) {
+			if (access.write && isAttachmentAccess(access.access) && access.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) {
+				needed[access.resource] = false;
+			}
+		}
+		for (auto& access : pass.m_accesses) {
+			bool keepsContents = !access.write || !isAttachmentAccess(access.access) || access.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+			if (keepsContents) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+void LibGFX::RenderGraph::validateReads()
+{
+	// A transient read with no writer before it in the sorted order would see undefined contents
+	std::vector<bool> written(m_resources.size(), false);
+	for (uint32_t passIndex : m_order) {
+		const RenderGraphPass& pass = m_passes[passIndex];
+		if (!pass.m_alive) {
+			continue;
+		}
+		for (const auto& access : pass.m_accesses) {
+			const Resource& resource = m_resources[access.resource];
+			bool readsContents = !access.write || (isAttachmentAccess(access.access) && access.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD);
+			if (readsContents && !resource.imported && !written[access.resource]) {
+				throw std::runtime_error("RenderGraph: pass '" + pass.m_name + "' reads '" + resource.name + "' before any pass writes it");
+			}
+		}
+		for (const auto& access : pass.m_accesses) {
+			if (access.write) {
+				written[access.resource] = true;
+			}
+		}
+	}
+}
+
+void LibGFX::RenderGraph::computeLifetimes()
+{
+	for (auto& resource : m_resources) {
+		resource.firstPass = ~0u;
+		resource.lastPass = 0;
+		resource.usage = 0;
+	}
+
+	// Lifetimes are positions in the execution order
+	for (uint32_t position = 0; position < m_order.size(); position++) {
+		RenderGraphPass& pass = m_passes[m_order[position]];
+		if (!pass.m_alive) {
+			continue;
+		}
+		for (auto& access : pass.m_accesses) {
+			Resource& resource = m_resources[access.resource];
+			resource.firstPass = std::min(resource.firstPass, position);
+			resource.lastPass = std::max(resource.lastPass, position);
+			resource.usage |= getAccessUsage(access.access);
+		}
+	}
+
+	// Attachment contents nobody reads afterwards are not written back to memory.
+	// A read only depth attachment stores nothing, DONT_CARE would allow the contents to be discarded.
+	// Store ops are only used with dynamic rendering, which brings STORE_OP_NONE.
+	for (uint32_t position = 0; position < m_order.size(); position++) {
+		for (auto& access : m_passes[m_order[position]].m_accesses) {
+			const Resource& resource = m_resources[access.resource];
+			bool lastUse = !resource.imported && resource.lastPass == position;
+			if (access.access == RenderGraphAccess::DepthRead) {
+				access.storeOp = VK_ATTACHMENT_STORE_OP_NONE;
+			}
+			else {
+				access.storeOp = lastUse ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+			}
+		}
+	}
+}
+
+void LibGFX::RenderGraph::createTransientImages(VkContext& context)
+{
+	VkDevice device = context.getDevice();
+	std::vector<uint32_t> transients;
+	uint32_t memoryTypeBits = ~0u;
+	for (uint32_t i = 0; i < m_resources.size(); i++) {
+		Resource& resource = m_resources[i];
+		if (resource.imported || resource.firstPass == ~0u) {
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { resource.desc.width, resource.desc.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateImage(device, &imageInfo, nullptr, &resource.image.image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render graph image '" + resource.name + "'");
+		}
+		vkGetImageMemoryRequirements(device, resource.image.image, &resource.requirements);
+		resource.image.format = resource.desc.format;
+		resource.image.width = resource.desc.width;
+		resource.image.height = resource.desc.height;
+
+		memoryTypeBits &= resource.requirements.memoryTypeBits;
+		m_stats.unaliasedBytes += resource.requirements.size;
+		transients.push_back(i);
+	}
+	m_stats.transientImageCount = static_cast<uint32_t>(transients.size());
+
+	if (!transients.empty() && memoryTypeBits != 0) {
+		// Biggest first, every image takes the lowest offset not used by an image alive at the same time
+		std::sort(transients.begin(), transients.end(), [&](uint32_t a, uint32_t b) {
+			return m_resources[a].requirements.size > m_resources[b].requirements.size;
+		});
+
+		VkMemoryRequirements heapRequirements = {};
+		heapRequirements.alignment = 1;
+		heapRequirements.memoryTypeBits = memoryTypeBits;
+		std::vector<uint32_t> placed;
+		for (uint32_t index : transients) {
+			Resource& resource = m_resources[index];
+			resource.aliased = true;
+			VkDeviceSize offset = 0;
+			bool moved = true;
+			while (moved) {
+				moved = false;
+				for (uint32_t other : placed) {
+					const Resource& placedResource = m_resources[other];
+					bool lifetimesOverlap = resource.firstPass <= placedResource.lastPass && placedResource.firstPass <= resource.lastPass;
+					bool rangesOverlap = offset < placedResource.memoryOffset + placedResource.requirements.size && placedResource.memoryOffset < offset + resource.requirements.size;
+					if (lifetimesOverlap && rangesOverlap) {
+						offset = alignUp(placedResource.memoryOffset + placedResource.requirements.size, resource.requirements.alignment);
+						moved = true;
+					}
+				}
+			}
+			resource.memoryOffset = offset;
+			placed.push_back(index);
+			heapRequirements.size = std::max(heapRequirements.size, offset + resource.requirements.size);
+			heapRequirements.alignment = std::max(heapRequirements.alignment, resource.requirements.alignment);
+		}
+
+		Image heap;
+		heap.allocation = context.getAllocator().allocate(heapRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		heap.memory = heap.allocation.memory;
+		m_heaps.push_back(heap);
+		m_stats.transientBytes = heapRequirements.size;
+		for (uint32_t index : transients) {
+			Resource& resource = m_resources[index];
+			vkBindImageMemory(device, resource.image.image, heap.memory, heap.allocation.offset + resource.memoryOffset);
+		}
+	}
+	else {
+		// No common memory type, every image gets its own allocation
+		for (uint32_t index : transients) {
+			Resource& resource = m_resources[index];
+			resource.aliased = false;
+			resource.image.allocation = context.getAllocator().allocate(resource.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+			resource.image.memory = resource.image.allocation.memory;
+			vkBindImageMemory(device, resource.image.image, resource.image.memory, resource.image.allocation.offset);
+			m_stats.transientBytes += resource.requirements.size;
+		}
+	}
+
+	for (uint32_t index : transients) {
+		Resource& resource = m_resources[index];
+		resource.image.imageView = context.createImageView(resource.image.image, resource.desc.format, resource.desc.aspect);
+	}
+}
+
+void LibGFX::RenderGraph::buildBarriers(bool emit)
+{
+	std::vector<ResourceState> states(m_resources.size());
+	std::vector<bool> touched(m_resources.size(), false);
+	uint32_t barrierCount = 0;
+	uint32_t batchCount = 0;
+	uint32_t skippedCount = 0;
+
+	auto makeBarrier = [&](RenderGraphResource index, VkImageLayout oldLayout, VkAccessFlags srcAccess, const ResourceState& desired) {
+		RenderGraphPass::Barrier entry;
+		entry.resource = index;
+		VkImageMemoryBarrier& barrier = entry.barrier;
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = desired.layout;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = desired.access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = m_resources[index].desc.aspect;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return entry;
+	};
+
+	for (uint32_t passIndex : m_order) {
+		RenderGraphPass& pass = m_passes[passIndex];
+		pass.m_barriers.clear();
+		pass.m_srcStageMask = 0;
+		pass.m_dstStageMask = 0;
+		if (!pass.m_alive) {
+			continue;
+		}
+
+		for (auto& access : pass.m_accesses) {
+			RenderGraphResource index = access.resource;
+			const Resource& resource = m_resources[index];
+			ResourceState desired = getAccessState(access.access);
+			ResourceState& state = states[index];
+
+			VkImageLayout oldLayout = state.layout;
+			VkPipelineStageFlags srcStage = state.stage;
+			VkAccessFlags srcAccess = state.access & WRITE_ACCESS_MASK;
+			if (!touched[index]) {
+				touched[index] = true;
+				if (resource.imported) {
+					oldLayout = resource.initialLayout;
+					// Same stage as the destination so the barrier chains with a swapchain acquire semaphore
+					srcStage = resource.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED ? desired.stage : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+					srcAccess = resource.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0 : VK_ACCESS_MEMORY_WRITE_BIT;
+				}
+				else {
+					// Contents are discarded, but the memory may still be in use by an aliased image or the previous frame
+					oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					srcStage = 0;
+					srcAccess = 0;
+					for (const auto& other : m_resources) {
+						if (!other.imported && other.firstPass != ~0u && sharesMemory(resource, other)) {
+							srcStage |= other.endState.stage;
+							srcAccess |= other.endState.access & WRITE_ACCESS_MASK;
+						}
+					}
+					if (srcStage == 0) {
+						srcStage = desired.stage;
+					}
+				}
+			}
+			else if (state.layout == desired.layout && (state.access & WRITE_ACCESS_MASK) == 0 && (desired.access & WRITE_ACCESS_MASK) == 0) {
+				// Read after read, later writers wait for all readers
+				state.stage |= desired.stage;
+				state.access |= desired.access;
+				skippedCount++;
+				continue;
+			}
+
+			pass.m_barriers.push_back(makeBarrier(index, oldLayout, srcAccess, desired));
+			pass.m_srcStageMask |= srcStage;
+			pass.m_dstStageMask |= desired.stage;
+			state = desired;
+		}
+
+		barrierCount += static_cast<uint32_t>(pass.m_barriers.size());
+		batchCount += pass.m_barriers.empty() ? 0 : 1;
+	}
+
+	// Imported images end in the layout their owner expects
+	m_finalBarriers.clear();
+	m_finalSrcStageMask = 0;
+	m_finalDstStageMask = 0;
+	for (RenderGraphResource index = 0; index < m_resources.size(); index++) {
+		const Resource& resource = m_resources[index];
+		if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			continue;
+		}
+
+		ResourceState state = touched[index] ? states[index] : ResourceState{ resource.initialLayout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT };
+		if (state.layout == resource.finalLayout) {
+			continue;
+		}
+
+		ResourceState desired;
+		desired.layout = resource.finalLayout;
+		desired.stage = resource.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		desired.access = resource.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+		m_finalBarriers.push_back(makeBarrier(index, state.layout, state.access & WRITE_ACCESS_MASK, desired));
+		m_finalSrcStageMask |= state.stage;
+		m_finalDstStageMask |= desired.stage;
+		states[index] = desired;
+	}
+	barrierCount += static_cast<uint32_t>(m_finalBarriers.size());
+	batchCount += m_finalBarriers.empty() ? 0 : 1;
+
+	if (!emit) {
+		for (RenderGraphResource index = 0; index < m_resources.size(); index++) {
+			m_resources[index].endState = states[index];
+		}
+		return;
+	}
+
+	m_stats.barrierCount = barrierCount;
+	m_stats.barrierBatchCount = batchCount;
+	m_stats.skippedBarrierCount = skippedCount;
+}
+
+void LibGFX::RenderGraph::releaseImages(VkContext& context, bool retire)
+{
+	// Aliased images own no memory, the heaps are released separately
+	for (auto& resource : m_resources) {
+		if (resource.imported) {
+			resource.image = {};
+			continue;
+		}
+		if (resource.image.image == VK_NULL_HANDLE) {
+			continue;
+		}
+		if (retire) {
+			context.retireImage(resource.image);
+		}
+		else {
+			context.destroyImage(resource.image);
+		}
+		resource.image = {};
+	}
+
+	for (auto& heap : m_heaps) {
+		if (retire) {
+			context.retireImage(heap);
+		}
+		else {
+			context.destroyImage(heap);
+		}
+	}
+	m_heaps.clear();
+}
+
+void LibGFX::RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphPass::Barrier>& barriers, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+{
+	if (barriers.empty()) {
+		return;
+	}
+
+	m_barrierScratch.clear();
+	for (const auto& entry : barriers) {
+		VkImageMemoryBarrier barrier = entry.barrier;
+		barrier.image = m_resources[entry.resource].image.image;
+		if (barrier.image == VK_NULL_HANDLE) {
+			throw std::runtime_error("RenderGraph: image '" + m_resources[entry.resource].name + "' is not bound");
+		}
+		m_barrierScratch.push_back(barrier);
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStageMask, dstStageMask,
+		0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(m_barrierScratch.size()), m_barrierScratch.data());
+}
+
+bool LibGFX::RenderGraph::sharesMemory(const Resource& a, const Resource& b) const
+{
+	if (&a == &b) {
+		return true;
+	}
+	if (!a.aliased || !b.aliased) {
+		return false;
+	}
+	return a.memoryOffset < b.memoryOffset + b.requirements.size && b.memoryOffset < a.memoryOffset + a.requirements.size;
+}
+
+LibGFX::RenderGraph::ResourceState LibGFX::RenderGraph::getAccessState(RenderGraphAccess access)
+{
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	switch (access) {
+	case RenderGraphAccess::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	case RenderGraphAccess::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case RenderGraphAccess::DepthRead:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depthStages | shaderStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT };
+	case RenderGraphAccess::Sampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shaderStages, VK_ACCESS_SHADER_READ_BIT };
+	case RenderGraphAccess::StorageRead:
+		return { VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_SHADER_READ_BIT };
+	case RenderGraphAccess::StorageWrite:
+		return { VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	case RenderGraphAccess::TransferSrc:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case RenderGraphAccess::TransferDst:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+	}
+	throw std::runtime_error("RenderGraph: unknown access");
+}
+
+VkImageUsageFlags LibGFX::RenderGraph::getAccessUsage(RenderGraphAccess access)
+{
+	switch (access) {
+	case RenderGraphAccess::ColorAttachment:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case RenderGraphAccess::DepthAttachment:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case RenderGraphAccess::DepthRead:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	case RenderGraphAccess::Sampled:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case RenderGraphAccess::StorageRead:
+	case RenderGraphAccess::StorageWrite:
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	case RenderGraphAccess::TransferSrc:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case RenderGraphAccess::TransferDst:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	return 0;
+}
+
+bool LibGFX::RenderGraph::isAttachmentAccess(RenderGraphAccess access)
+{
+	return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment || access == RenderGraphAccess::DepthRead;
+}
+
+bool LibGFX::RenderGraph::isWriteAccess(RenderGraphAccess access)
+{
+	return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment
+		|| access == RenderGraphAccess::StorageWrite || access == RenderGraphAccess::TransferDst;
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Index of an image declared in a RenderGraph
+	using RenderGraphResource = uint32_t;
+
+	// How a pass uses an image, decides the layout, stages and access flags of its barriers
+	enum class RenderGraphAccess {
+		ColorAttachment,
+		DepthAttachment,
+		DepthRead,	// Read only depth attachment, may be sampled at the same time
+		Sampled,
+		StorageRead,
+		StorageWrite,
+		TransferSrc,
+		TransferDst
+	};
+
+	// Image created by the graph, its memory is only reserved for the passes that use it
+	struct RenderGraphImageDesc {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	};
+
+	// Result of the last compile, barrier counts are per execution
+	struct RenderGraphStats {
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t transientImageCount = 0;
+		uint32_t barrierCount = 0;
+		uint32_t barrierBatchCount = 0;	// vkCmdPipelineBarrier calls
+		uint32_t skippedBarrierCount = 0;	// Reads after reads in the same layout
+		VkDeviceSize transientBytes = 0;	// Memory of all transient images after aliasing
+		VkDeviceSize unaliasedBytes = 0;	// Memory they would need with one allocation each
+	};
+
+	class RenderGraph;
+
+	// Declares the images a pass reads and writes, returned by RenderGraph::addPass
+	class RenderGraphPass
+	{
+	public:
+		using ExecuteCallback = std::function<void(VkCommandBuffer, RenderGraph&)>;
+
+		RenderGraphPass(const std::string& name, ExecuteCallback callback);
+
+		RenderGraphPass& read(RenderGraphResource resource, RenderGraphAccess access = RenderGraphAccess::Sampled);
+		// Attachments with LOAD_OP_LOAD keep the producer of the previous contents alive
+		RenderGraphPass& write(RenderGraphResource resource, RenderGraphAccess access = RenderGraphAccess::ColorAttachment, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearValue clearValue = {});
+		// Never culled, e.g. for passes writing buffers the graph does not know about
+		RenderGraphPass& setSideEffect();
+		// The callback begins its own RenderPass. Attachments are handed over in their attachment layout
+		// and must be left in it, so the render pass uses the same initial and final layout.
+		RenderGraphPass& setManualRendering();
+
+		const std::string& getName() const { return m_name; }
+		bool isCulled() const { return !m_alive; }
+	private:
+		friend class RenderGraph;
+
+		struct Access {
+			RenderGraphResource resource = 0;
+			RenderGraphAccess access = RenderGraphAccess::Sampled;
+			bool write = false;
+			VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			VkClearValue clearValue = {};
+		};
+
+		struct Barrier {
+			RenderGraphResource resource = 0;
+			VkImageMemoryBarrier barrier = {};
+		};
+
+		std::string m_name;
+		ExecuteCallback m_callback;
+		std::vector<Access> m_accesses;
+		bool m_sideEffect = false;
+		bool m_manualRendering = false;
+
+		// Compile results
+		bool m_alive = false;
+		bool m_hasAttachments = false;
+		std::vector<Barrier> m_barriers;
+		VkPipelineStageFlags m_srcStageMask = 0;
+		VkPipelineStageFlags m_dstStageMask = 0;
+	};
+
+	// Frame graph on top of VkContext. Passes declare the images they read and write, compile() culls
+	// passes whose results are never consumed, precomputes one batched barrier per pass and places
+	// transient images with disjoint lifetimes in the same memory. Passes are sorted by their read/write
+	// dependencies, a read waits for the writer declared before it (or the last writer if none is), writers
+	// of the same image keep their declaration order. Independent passes keep their declaration order.
+	// The graph is persistent: build and compile once, execute every frame, reset and rebuild on resize.
+	class RenderGraph
+	{
+	public:
+		RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+		// External image (e.g. the swapchain image) bound per frame with setImportedImage
+		RenderGraphResource importImage(const std::string& name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+		RenderGraphPass& addPass(const std::string& name, RenderGraphPass::ExecuteCallback callback);
+
+		void compile(VkContext& context);
+		void setImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView);
+		void execute(VkContext& context, VkCommandBuffer commandBuffer);
+
+		// Drops all passes and resources, the images are retired until the GPU is done with them
+		void reset(VkContext& context);
+		void destroy(VkContext& context);
+
+		VkImage getImage(RenderGraphResource resource) const;
+		VkImageView getImageView(RenderGraphResource resource) const;
+		VkExtent2D getExtent(RenderGraphResource resource) const;
+		const RenderGraphStats& getStats() const { return m_stats; }
+	private:
+		struct ResourceState {
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags stage = 0;
+			VkAccessFlags access = 0;
+		};
+
+		struct Resource {
+			std::string name;
+			RenderGraphImageDesc desc;
+			bool imported = false;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageUsageFlags usage = 0;
+			Image image = {};
+			VkMemoryRequirements requirements = {};
+			VkDeviceSize memoryOffset = 0;
+			bool aliased = false;
+			uint32_t firstPass = ~0u;
+			uint32_t lastPass = 0;
+			ResourceState endState;
+		};
+
+		std::vector<Resource> m_resources;
+		std::deque<RenderGraphPass> m_passes;
+		std::vector<Image> m_heaps;
+		std::vector<RenderGraphPass::Barrier> m_finalBarriers;
+		VkPipelineStageFlags m_finalSrcStageMask = 0;
+		VkPipelineStageFlags m_finalDstStageMask = 0;
+		std::vector<VkImageMemoryBarrier> m_barrierScratch;
+		std::vector<RenderingAttachment> m_colorScratch;
+		RenderGraphStats m_stats;
+		std::vector<uint32_t> m_order;	// Execution order, indices into m_passes
+		bool m_compiled = false;
+
+		void sortPasses();
+		void cullPasses();
+		void validateReads();
+		void computeLifetimes();
+		void createTransientImages(VkContext& context);
+		void buildBarriers(bool emit);
+		void releaseImages(VkContext& context, bool retire);
+		void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphPass::Barrier>& barriers, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+		bool sharesMemory(const Resource& a, const Resource& b) const;
+
+		static ResourceState getAccessState(RenderGraphAccess access);
+		static VkImageUsageFlags getAccessUsage(RenderGraphAccess access);
+		static bool isAttachmentAccess(RenderGraphAccess access);
+		static bool isWriteAccess(RenderGraphAccess access);
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace LibGFX {
+
+	// Attachment of a dynamic rendering pass, the image view is used directly without a framebuffer
+	struct RenderingAttachment {
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkImageLayout imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		VkClearValue clearValue = {};
+		VkImageView resolveImageView = VK_NULL_HANDLE;
+		VkImageLayout resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkResolveModeFlagBits resolveMode = VK_RESOLVE_MODE_NONE;
+		VkFormat format = VK_FORMAT_UNDEFINED;	// Depth attachments only: a format with stencil binds the stencil attachment as well
+	};
+
+	// Attachment formats a pipeline or secondary command buffer is compatible with.
+	// Replaces the render pass compatibility of the classic path.
+	struct RenderingFormats {
+		std::vector<VkFormat> colorFormats;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkFormat stencilFormat = VK_FORMAT_UNDEFINED;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		uint32_t viewMask = 0;
+	};
+}
@@ -6,7 +6,9 @@ struct SwapchainInfo {
 	VkSwapchainKHR swapchain;
 	VkExtent2D extent;
 	VkSurfaceFormatKHR surfaceFormat;
+	VkPresentModeKHR presentMode;
 	uint32_t imageCount;
+	VkImageUsageFlags imageUsage;	// TRANSFER_SRC only where the surface supports it, see ReadbackPool
 	std::vector<VkImage> images;
 	std::vector<VkImageView> imageViews;
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "TextureArrayPacker.h"
+#include <algorithm>
+#include <stdexcept>
+
+void LibGFX::TextureArrayPacker::create(VkContext& context, uint32_t layersPerArray /*= DEFAULT_LAYERS_PER_ARRAY*/)
+{
+	uint32_t maxLayers = context.getPhysicalDeviceProperties().limits.maxImageArrayLayers;
+	m_layersPerArray = std::max(1u, std::min(layersPerArray, maxLayers));
+}
+
+void LibGFX::TextureArrayPacker::destroy(VkContext& context)
+{
+	for (auto& textureArray : m_arrays) {
+		context.destroyImage(textureArray.image);
+	}
+	m_arrays.clear();
+}
+
+LibGFX::PackedTexture LibGFX::TextureArrayPacker::add(VkContext& context, UploadContext& uploadContext, const ImageData& imageData)
+{
+	// Reuse freed layers first, then unwritten ones, so existing arrays fill up before a new one is created
+	PackedTexture texture = {};
+	bool found = false;
+	for (uint32_t i = 0; i < m_arrays.size() && !found; i++) {
+		TextureArray& textureArray = m_arrays[i];
+		if (!isCompatible(textureArray, imageData)) {
+			continue;
+		}
+		if (!textureArray.freeLayers.empty()) {
+			texture = { i, textureArray.freeLayers.back() };
+			textureArray.freeLayers.pop_back();
+			found = true;
+		}
+		else if (textureArray.nextLayer < textureArray.capacity) {
+			texture = { i, textureArray.nextLayer++ };
+			found = true;
+		}
+	}
+
+	bool newImage = !found;
+	if (newImage) {
+		texture = { createArray(context, imageData), 0 };
+		m_arrays[texture.array].nextLayer = 1;
+	}
+
+	TextureArray& textureArray = m_arrays[texture.array];
+	uploadContext.enqueueImageLayer(context, textureArray.image.image, textureArray.capacity, texture.layer, imageData, newImage);
+	return texture;
+}
+
+void LibGFX::TextureArrayPacker::remove(PackedTexture texture)
+{
+	TextureArray& textureArray = m_arrays.at(texture.array);
+	if (texture.layer >= textureArray.nextLayer) {
+		throw std::runtime_error("TextureArrayPacker: layer was never packed");
+	}
+	textureArray.freeLayers.push_back(texture.layer);
+}
+
+uint32_t LibGFX::TextureArrayPacker::getUsedLayerCount(uint32_t array) const
+{
+	const TextureArray& textureArray = m_arrays.at(array);
+	return textureArray.nextLayer - static_cast<uint32_t>(textureArray.freeLayers.size());
+}
+
+bool LibGFX::TextureArrayPacker::isCompatible(const TextureArray& textureArray, const ImageData& imageData) const
+{
+	const Image& image = textureArray.image;
+	return image.format == imageData.format && image.width == imageData.width && image.height == imageData.height && image.mipLevels == imageData.mipLevels;
+}
+
+uint32_t LibGFX::TextureArrayPacker::createArray(VkContext& context, const ImageData& imageData)
+{
+	if (!context.isFormatSupported(imageData.format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		throw std::runtime_error("TextureArrayPacker: format can not be sampled on this device");
+	}
+
+	TextureArray textureArray = {};
+	textureArray.capacity = m_layersPerArray;
+	Image& image = textureArray.image;
+	image.image = context.createVkImage(
+		imageData.width,
+		imageData.height,
+		imageData.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&image.allocation,
+		textureArray.capacity,
+		0,
+		imageData.mipLevels);
+	image.memory = image.allocation.memory;
+	image.imageView = context.createImageView(image.image, imageData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, textureArray.capacity, imageData.mipLevels);
+	image.format = imageData.format;
+	image.width = imageData.width;
+	image.height = imageData.height;
+	image.mipLevels = imageData.mipLevels;
+
+	m_arrays.push_back(std::move(textureArray));
+	return static_cast<uint32_t>(m_arrays.size() - 1);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "VkContext.h"
+#include "UploadContext.h"
+
+namespace LibGFX {
+
+	// Location of a texture packed by TextureArrayPacker, the shader samples layer of array
+	struct PackedTexture {
+		uint32_t array = 0;
+		uint32_t layer = 0;
+	};
+
+	// Groups textures of the same format, size and mip count into 2D array images, so thousands of small
+	// textures share a handful of images, views and descriptors. Arrays have a fixed number of layers:
+	// new textures are uploaded into a free layer of a matching array without touching the other layers,
+	// a new array is only created once all matching arrays are full.
+	class TextureArrayPacker
+	{
+	public:
+		static constexpr uint32_t DEFAULT_LAYERS_PER_ARRAY = 64;
+
+		void create(VkContext& context, uint32_t layersPerArray = DEFAULT_LAYERS_PER_ARRAY);
+		void destroy(VkContext& context);
+
+		// The upload is recorded into the upload context, the layer may be sampled once that batch is complete
+		PackedTexture add(VkContext& context, UploadContext& uploadContext, const ImageData& imageData);
+		// Frees the layer for a later texture, the caller makes sure the GPU no longer samples it
+		void remove(PackedTexture texture);
+
+		uint32_t getArrayCount() const { return static_cast<uint32_t>(m_arrays.size()); }
+		// View type VK_IMAGE_VIEW_TYPE_2D_ARRAY over all layers of the array
+		const Image& getArray(uint32_t array) const { return m_arrays.at(array).image; }
+		uint32_t getLayerCount(uint32_t array) const { return m_arrays.at(array).capacity; }
+		uint32_t getUsedLayerCount(uint32_t array) const;
+	private:
+		struct TextureArray {
+			Image image = {};
+			uint32_t capacity = 0;
+			uint32_t nextLayer = 0;	// Layers above were never written
+			std::vector<uint32_t> freeLayers;
+		};
+
+		std::vector<TextureArray> m_arrays;
+		uint32_t m_layersPerArray = DEFAULT_LAYERS_PER_ARRAY;
+
+		bool isCompatible(const TextureArray& textureArray, const ImageData& imageData) const;
+		uint32_t createArray(VkContext& context, const ImageData& imageData);
+	};
+}
@@ -0,0 +1,397 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <stdexcept>
+
+void LibGFX::TextureStreamer::create(VkContext& context, VkDeviceSize memoryBudget, uint32_t tailSize /*= 64*/, VkDeviceSize uploadBytesPerUpdate /*= DEFAULT_UPLOAD_BYTES_PER_UPDATE*/)
+{
+	m_uploadContext.create(context);
+	m_memoryBudget = memoryBudget;
+	m_tailSize = std::max(tailSize, 1u);
+	m_uploadBytesPerUpdate = uploadBytesPerUpdate;
+	m_frame = 0;
+}
+
+void LibGFX::TextureStreamer::destroy(VkContext& context)
+{
+	flush(context);
+	for (auto& texture : m_textures) {
+		if (texture.alive && texture.image.image != VK_NULL_HANDLE) {
+			context.destroyImage(texture.image);
+		}
+	}
+	m_textures.clear();
+	m_freeTextures.clear();
+	m_unsubmitted.clear();
+	m_retiring.clear();
+	m_uploadContext.destroy(context);
+}
+
+LibGFX::StreamedTexture LibGFX::TextureStreamer::addTexture(VkContext& context, ImageData imageData)
+{
+	if (imageData.mipLevels == 0 || imageData.pixels.size() < imageData.getTotalSize()) {
+		throw std::runtime_error("TextureStreamer: image data does not hold its mip levels");
+	}
+
+	StreamedTexture handle;
+	if (!m_freeTextures.empty()) {
+		handle = m_freeTextures.back();
+		m_freeTextures.pop_back();
+	}
+	else {
+		handle = static_cast<StreamedTexture>(m_textures.size());
+		m_textures.emplace_back();
+	}
+
+	// The tail is the first level that fits into tailSize, or the last level of a short chain
+	Texture& texture = m_textures[handle];
+	texture = Texture();
+	texture.data = std::move(imageData);
+	texture.imageSizes.assign(texture.data.mipLevels, 0);
+	texture.tailLevel = texture.data.mipLevels - 1;
+	for (uint32_t level = 0; level < texture.data.mipLevels; level++) {
+		if (std::max(getMipDimension(texture.data.width, level), getMipDimension(texture.data.height, level)) <= m_tailSize) {
+			texture.tailLevel = level;
+			break;
+		}
+	}
+	texture.residentLevel = texture.data.mipLevels;
+	texture.desiredLevel = texture.tailLevel;
+	texture.lastRequestFrame = m_frame;
+	texture.alive = true;
+
+	// The tail ignores the budget, a texture without any level can not be sampled
+	startUpload(context, handle, texture.tailLevel);
+	return handle;
+}
+
+void LibGFX::TextureStreamer::removeTexture(VkContext& context, StreamedTexture texture)
+{
+	Texture& entry = m_textures.at(texture);
+	if (!entry.alive) {
+		return;
+	}
+
+	// Retirement only covers submitted work, the pending upload must not stay in the recording
+	if (entry.pending) {
+		submit(context);
+		retireImage(context, entry.pendingImage);
+	}
+	if (entry.image.image != VK_NULL_HANDLE) {
+		retireImage(context, entry.image);
+	}
+	entry = Texture();
+	m_freeTextures.push_back(texture);
+}
+
+void LibGFX::TextureStreamer::requestLevel(StreamedTexture texture, uint32_t level)
+{
+	Texture& entry = m_textures.at(texture);
+	entry.requestedLevel = std::min(entry.requestedLevel, level);
+}
+
+void LibGFX::TextureStreamer::update(VkContext& context)
+{
+	m_frameStats = TextureStreamerStats();
+	completeUploads(context);
+	collectRetiringImages(context);
+	updateDesiredLevels();
+
+	// Memory the textures requested this frame still need, the current image lives on until its replacement is done
+	VkDeviceSize demandBytes = 0;
+	for (const auto& texture : m_textures) {
+		if (texture.alive && !texture.pending && texture.lastRequestFrame == m_frame && texture.desiredLevel < texture.residentLevel) {
+			demandBytes += getImageBytes(texture, texture.desiredLevel);
+		}
+	}
+
+	VkDeviceSize settledBytes = getSettledBytes();
+	VkDeviceSize committedBytes = getCommittedBytes();
+	VkDeviceSize uploadBudget = m_uploadBytesPerUpdate;
+	evict(context, demandBytes, settledBytes, committedBytes, uploadBudget);
+	streamIn(context, committedBytes, uploadBudget);
+	submit(context);
+	m_frame++;
+}
+
+void LibGFX::TextureStreamer::flush(VkContext& context)
+{
+	submit(context);
+	for (const auto& texture : m_textures) {
+		if (texture.alive && texture.pending) {
+			m_uploadContext.wait(context, texture.pendingTicket);
+		}
+	}
+	completeUploads(context);
+}
+
+VkImageView LibGFX::TextureStreamer::getImageView(StreamedTexture texture) const
+{
+	return getTexture(texture).image.imageView;
+}
+
+bool LibGFX::TextureStreamer::isReady(StreamedTexture texture) const
+{
+	return getTexture(texture).image.image != VK_NULL_HANDLE;
+}
+
+uint32_t LibGFX::TextureStreamer::getResidentLevel(StreamedTexture texture) const
+{
+	return getTexture(texture).residentLevel;
+}
+
+uint32_t LibGFX::TextureStreamer::getVersion(StreamedTexture texture) const
+{
+	return getTexture(texture).version;
+}
+
+LibGFX::TextureStreamerStats LibGFX::TextureStreamer::getStats() const
+{
+	TextureStreamerStats stats = m_frameStats;
+	stats.memoryBudget = m_memoryBudget;
+	for (const auto& texture : m_textures) {
+		if (!texture.alive) {
+			continue;
+		}
+		stats.textureCount++;
+		stats.residentBytes += texture.image.allocation.size;
+		if (texture.pending) {
+			stats.pendingUploadCount++;
+			stats.pendingBytes += texture.pendingImage.allocation.size;
+		}
+	}
+	for (const auto& retiring : m_retiring) {
+		stats.retiringBytes += retiring.size;
+	}
+	return stats;
+}
+
+void LibGFX::TextureStreamer::completeUploads(VkContext& context)
+{
+	for (auto& texture : m_textures) {
+		if (!texture.alive || !texture.pending || texture.pendingTicket.id == 0) {
+			continue;
+		}
+		if (!m_uploadContext.isComplete(context, texture.pendingTicket)) {
+			continue;
+		}
+
+		// Frames in flight may still sample the old image
+		if (texture.image.image != VK_NULL_HANDLE) {
+			retireImage(context, texture.image);
+		}
+		texture.image = texture.pendingImage;
+		texture.pendingImage = {};
+		texture.residentLevel = texture.pendingLevel;
+		texture.pending = false;
+		texture.pendingTicket = {};
+		texture.version++;
+	}
+}
+
+void LibGFX::TextureStreamer::updateDesiredLevels()
+{
+	// Textures without a request keep their last wish and become eviction candidates as they age
+	for (auto& texture : m_textures) {
+		if (!texture.alive || texture.requestedLevel == NO_REQUEST) {
+			continue;
+		}
+		texture.desiredLevel = std::min(texture.requestedLevel, texture.tailLevel);
+		texture.lastRequestFrame = m_frame;
+		texture.requestedLevel = NO_REQUEST;
+	}
+}
+
+void LibGFX::TextureStreamer::evict(VkContext& context, VkDeviceSize demandBytes, VkDeviceSize& settledBytes, VkDeviceSize& committedBytes, VkDeviceSize& uploadBudget)
+{
+	// Evicting frees memory only once the smaller image is done and the old one is collected, so plan on the settled bytes
+	if (settledBytes + demandBytes <= m_memoryBudget) {
+		return;
+	}
+
+	// Textures holding levels they no longer want go first, then the least recently requested, finest levels first
+	m_candidates.clear();
+	for (StreamedTexture handle = 0; handle < m_textures.size(); handle++) {
+		const Texture& texture = m_textures[handle];
+		if (texture.alive && !texture.pending && texture.residentLevel < texture.tailLevel) {
+			m_candidates.push_back(handle);
+		}
+	}
+	std::sort(m_candidates.begin(), m_candidates.end(), [this](StreamedTexture a, StreamedTexture b) {
+		const Texture& textureA = m_textures[a];
+		const Texture& textureB = m_textures[b];
+		bool unwantedA = textureA.residentLevel < textureA.desiredLevel;
+		bool unwantedB = textureB.residentLevel < textureB.desiredLevel;
+		if (unwantedA != unwantedB) {
+			return unwantedA;
+		}
+		if (textureA.lastRequestFrame != textureB.lastRequestFrame) {
+			return textureA.lastRequestFrame < textureB.lastRequestFrame;
+		}
+		return textureA.residentLevel < textureB.residentLevel;
+	});
+
+	for (StreamedTexture handle : m_candidates) {
+		if (settledBytes + demandBytes <= m_memoryBudget) {
+			break;
+		}
+
+		// Levels requested this frame are only sacrificed when the residency itself is over the budget
+		Texture& texture = m_textures[handle];
+		bool unwanted = texture.residentLevel < texture.desiredLevel;
+		if (!unwanted && texture.lastRequestFrame == m_frame && settledBytes <= m_memoryBudget) {
+			continue;
+		}
+
+		// Unwanted levels go at once, further levels only as long as the budget is exceeded
+		VkDeviceSize residentBytes = texture.image.allocation.size;
+		uint32_t level = unwanted ? texture.desiredLevel : texture.residentLevel + 1;
+		while (level < texture.tailLevel && settledBytes - residentBytes + getImageBytes(texture, level) + demandBytes > m_memoryBudget) {
+			level++;
+		}
+
+		VkDeviceSize levelBytes = getLevelBytes(texture, level);
+		if (levelBytes > uploadBudget && m_frameStats.uploadedBytes > 0) {
+			break;
+		}
+		m_frameStats.evictedLevels += level - texture.residentLevel;
+		startUpload(context, handle, level);
+		settledBytes = settledBytes - residentBytes + texture.pendingImage.allocation.size;
+		committedBytes += texture.pendingImage.allocation.size;
+		uploadBudget -= std::min(uploadBudget, levelBytes);
+	}
+}
+
+void LibGFX::TextureStreamer::streamIn(VkContext& context, VkDeviceSize& committedBytes, VkDeviceSize& uploadBudget)
+{
+	// Most recently requested first, then the textures missing the most levels
+	m_candidates.clear();
+	for (StreamedTexture handle = 0; handle < m_textures.size(); handle++) {
+		const Texture& texture = m_textures[handle];
+		if (texture.alive && !texture.pending && texture.desiredLevel < texture.residentLevel) {
+			m_candidates.push_back(handle);
+		}
+	}
+	std::sort(m_candidates.begin(), m_candidates.end(), [this](StreamedTexture a, StreamedTexture b) {
+		const Texture& textureA = m_textures[a];
+		const Texture& textureB = m_textures[b];
+		if (textureA.lastRequestFrame != textureB.lastRequestFrame) {
+			return textureA.lastRequestFrame > textureB.lastRequestFrame;
+		}
+		return textureA.residentLevel - textureA.desiredLevel > textureB.residentLevel - textureB.desiredLevel;
+	});
+
+	for (StreamedTexture handle : m_candidates) {
+		Texture& texture = m_textures[handle];
+
+		// Stream in as many of the wanted levels as the budget allows, next to the current image
+		uint32_t level = texture.desiredLevel;
+		while (level < texture.residentLevel && committedBytes + getImageBytes(texture, level) > m_memoryBudget) {
+			level++;
+		}
+		if (level >= texture.residentLevel) {
+			continue;
+		}
+
+		// At least one upload per update, even if it is larger than the per update limit
+		VkDeviceSize levelBytes = getLevelBytes(texture, level);
+		if (levelBytes > uploadBudget && m_frameStats.uploadedBytes > 0) {
+			break;
+		}
+		m_frameStats.streamedLevels += texture.residentLevel - level;
+		startUpload(context, handle, level);
+		committedBytes += texture.pendingImage.allocation.size;
+		uploadBudget -= std::min(uploadBudget, levelBytes);
+	}
+}
+
+void LibGFX::TextureStreamer::startUpload(VkContext& context, StreamedTexture texture, uint32_t level)
+{
+	Texture& entry = m_textures[texture];
+	entry.pendingImage = m_uploadContext.enqueueImageLevels(context, entry.data, level);
+	entry.imageSizes[level] = entry.pendingImage.allocation.size;
+	entry.pendingLevel = level;
+	entry.pendingTicket = {};
+	entry.pending = true;
+	m_unsubmitted.push_back(texture);
+	m_frameStats.uploadedBytes += getLevelBytes(entry, level);
+}
+
+void LibGFX::TextureStreamer::submit(VkContext& context)
+{
+	if (m_unsubmitted.empty()) {
+		return;
+	}
+
+	UploadTicket ticket = m_uploadContext.submit(context);
+	for (StreamedTexture texture : m_unsubmitted) {
+		Texture& entry = m_textures[texture];
+		if (entry.alive && entry.pending) {
+			entry.pendingTicket = ticket;
+		}
+	}
+	m_unsubmitted.clear();
+}
+
+void LibGFX::TextureStreamer::retireImage(VkContext& context, Image& image)
+{
+	VkDeviceSize size = image.allocation.size;
+	m_retiring.push_back({ size, context.retireImage(image) });
+}
+
+void LibGFX::TextureStreamer::collectRetiringImages(VkContext& context)
+{
+	m_retiring.erase(std::remove_if(m_retiring.begin(), m_retiring.end(), [&context](const RetiringImage& retiring) {
+		return context.isRetirementCollected(retiring.retirement);
+	}), m_retiring.end());
+}
+
+VkDeviceSize LibGFX::TextureStreamer::getCommittedBytes() const
+{
+	VkDeviceSize committedBytes = 0;
+	for (const auto& texture : m_textures) {
+		if (texture.alive) {
+			committedBytes += texture.image.allocation.size + (texture.pending ? texture.pendingImage.allocation.size : 0);
+		}
+	}
+	for (const auto& retiring : m_retiring) {
+		committedBytes += retiring.size;
+	}
+	return committedBytes;
+}
+
+VkDeviceSize LibGFX::TextureStreamer::getSettledBytes() const
+{
+	VkDeviceSize settledBytes = 0;
+	for (const auto& texture : m_textures) {
+		if (texture.alive) {
+			settledBytes += texture.pending ? texture.pendingImage.allocation.size : texture.image.allocation.size;
+		}
+	}
+	return settledBytes;
+}
+
+const LibGFX::TextureStreamer::Texture& LibGFX::TextureStreamer::getTexture(StreamedTexture texture) const
+{
+	const Texture& entry = m_textures.at(texture);
+	if (!entry.alive) {
+		throw std::runtime_error("TextureStreamer: texture was removed");
+	}
+	return entry;
+}
+
+VkDeviceSize LibGFX::TextureStreamer::getLevelBytes(const Texture& texture, uint32_t level)
+{
+	if (level >= texture.data.mipLevels) {
+		return 0;
+	}
+	return texture.data.getTotalSize() - texture.data.getMipOffset(level);
+}
+
+VkDeviceSize LibGFX::TextureStreamer::getImageBytes(const Texture& texture, uint32_t level)
+{
+	if (level >= texture.data.mipLevels) {
+		return 0;
+	}
+	// Until an image starting at the level was created the packed size is the best guess
+	return texture.imageSizes[level] != 0 ? texture.imageSizes[level] : getLevelBytes(texture, level);
+}
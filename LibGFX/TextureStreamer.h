@@ -0,0 +1,118 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <limits>
+#include "VkContext.h"
+#include "UploadContext.h"
+
+namespace LibGFX {
+
+	// Index of a texture added to a TextureStreamer
+	using StreamedTexture = uint32_t;
+
+	struct TextureStreamerStats {
+		uint32_t textureCount = 0;
+		uint32_t pendingUploadCount = 0;
+		VkDeviceSize memoryBudget = 0;
+		VkDeviceSize residentBytes = 0;	// Memory of all current images
+		VkDeviceSize pendingBytes = 0;	// Images being uploaded, replace the current ones when done
+		VkDeviceSize retiringBytes = 0;	// Replaced images frames in flight may still sample
+		VkDeviceSize uploadedBytes = 0;	// Last update
+		uint32_t streamedLevels = 0;	// Last update
+		uint32_t evictedLevels = 0;	// Last update
+	};
+
+	// Streams the mip levels of textures in and out under a memory budget. A texture starts with its mip
+	// tail (levels up to tailSize pixels) and the renderer reports the finest level it needs every frame
+	// with requestLevel. update() uploads finer levels in the background and, when the budget is exceeded,
+	// drops the finest levels of the textures that were requested longest ago.
+	// A residency change uploads a new image holding exactly the resident levels from the CPU copy of the
+	// data and swaps it in once the upload is done, so shaders need no LOD clamp. Rewrite descriptors
+	// whenever getVersion changes; replaced images are retired through VkContext.
+	// The budget covers the device memory of current, pending and retired images until VkContext collects
+	// them, so call collectRetiredResources every frame.
+	class TextureStreamer
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_UPLOAD_BYTES_PER_UPDATE = 16ull * 1024 * 1024;
+		static constexpr uint32_t NO_REQUEST = std::numeric_limits<uint32_t>::max();
+
+		void create(VkContext& context, VkDeviceSize memoryBudget, uint32_t tailSize = 64, VkDeviceSize uploadBytesPerUpdate = DEFAULT_UPLOAD_BYTES_PER_UPDATE);
+		void destroy(VkContext& context);
+
+		// The data must contain the full mip chain, the tail is uploaded with the next update
+		StreamedTexture addTexture(VkContext& context, ImageData imageData);
+		void removeTexture(VkContext& context, StreamedTexture texture);
+
+		// Feedback for the current frame, the finest request of the frame wins
+		void requestLevel(StreamedTexture texture, uint32_t level);
+		// Once per frame: swaps in finished uploads, evicts over the budget and starts new uploads
+		void update(VkContext& context);
+		// Submits everything and waits for it, e.g. at the end of a loading screen
+		void flush(VkContext& context);
+
+		void setMemoryBudget(VkDeviceSize memoryBudget) { m_memoryBudget = memoryBudget; }
+		VkImageView getImageView(StreamedTexture texture) const;
+		bool isReady(StreamedTexture texture) const;
+		uint32_t getResidentLevel(StreamedTexture texture) const;
+		uint32_t getVersion(StreamedTexture texture) const;
+		TextureStreamerStats getStats() const;
+	private:
+		struct Texture {
+			ImageData data;
+			Image image = {};	// Holds levels [residentLevel, mipLevels)
+			uint32_t residentLevel = 0;
+			uint32_t tailLevel = 0;
+			uint32_t requestedLevel = NO_REQUEST;	// Finest request of the current frame
+			uint32_t desiredLevel = 0;
+			uint64_t lastRequestFrame = 0;
+			uint32_t version = 0;
+			bool alive = false;
+
+			// Upload replacing the image when its ticket completes
+			Image pendingImage = {};
+			uint32_t pendingLevel = 0;
+			UploadTicket pendingTicket = {};
+			bool pending = false;
+
+			// Allocation size of an image starting at each level, 0 until such an image was created
+			std::vector<VkDeviceSize> imageSizes;
+		};
+
+		struct RetiringImage {
+			VkDeviceSize size = 0;
+			uint64_t retirement = 0;
+		};
+
+		UploadContext m_uploadContext;
+		std::vector<Texture> m_textures;
+		std::vector<StreamedTexture> m_freeTextures;
+		std::vector<StreamedTexture> m_unsubmitted;	// Pending uploads recorded since the last submit
+		std::vector<StreamedTexture> m_candidates;
+		std::vector<RetiringImage> m_retiring;
+		VkDeviceSize m_memoryBudget = 0;
+		VkDeviceSize m_uploadBytesPerUpdate = DEFAULT_UPLOAD_BYTES_PER_UPDATE;
+		uint32_t m_tailSize = 64;
+		uint64_t m_frame = 0;
+		TextureStreamerStats m_frameStats;
+
+		void completeUploads(VkContext& context);
+		void updateDesiredLevels();
+		void evict(VkContext& context, VkDeviceSize demandBytes, VkDeviceSize& settledBytes, VkDeviceSize& committedBytes, VkDeviceSize& uploadBudget);
+		void streamIn(VkContext& context, VkDeviceSize& committedBytes, VkDeviceSize& uploadBudget);
+		void startUpload(VkContext& context, StreamedTexture texture, uint32_t level);
+		void submit(VkContext& context);
+		void retireImage(VkContext& context, Image& image);
+		void collectRetiringImages(VkContext& context);
+		// Device memory of all current, pending and retiring images
+		VkDeviceSize getCommittedBytes() const;
+		// Device memory once all pending uploads have replaced their images and the retired ones are gone
+		VkDeviceSize getSettledBytes() const;
+		const Texture& getTexture(StreamedTexture texture) const;
+
+		// Upload size of the levels [level, mipLevels)
+		static VkDeviceSize getLevelBytes(const Texture& texture, uint32_t level);
+		// Device memory of an image holding the levels [level, mipLevels)
+		static VkDeviceSize getImageBytes(const Texture& texture, uint32_t level);
+	};
+}
@@ -0,0 +1,251 @@
+#include "TraceRecorder.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+	const char* getCounterArgName(LibGFX::TraceCounter counter)
+	{
+		switch (counter) {
+		case LibGFX::TraceCounter::Allocation:
+		case LibGFX::TraceCounter::Upload:
+			return "bytes";
+		default:
+			return "value";
+		}
+	}
+
+	void writeEscaped(std::ostream& stream, const char* text)
+	{
+		for (const char* c = text; *c != '\0'; c++) {
+			switch (*c) {
+			case '"': stream << "\\\""; break;
+			case '\\': stream << "\\\\"; break;
+			case '\n': stream << "\\n"; break;
+			case '\t': stream << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(*c) < 0x20) {
+					stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*c) << std::dec << std::setfill(' ');
+				}
+				else {
+					stream << *c;
+				}
+			}
+		}
+	}
+}
+
+LibGFX::TraceRecorder::TraceRecorder(size_t maxEvents /*= DEFAULT_MAX_EVENTS*/)
+	: m_startTime(std::chrono::steady_clock::now()), m_maxEvents(maxEvents)
+{
+}
+
+uint64_t LibGFX::TraceRecorder::now() const
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count());
+}
+
+void LibGFX::TraceRecorder::addEvent(const char* name, const char* category, uint64_t startUs, uint64_t endUs, TraceCounter counter /*= TraceCounter::None*/, uint64_t value /*= 0*/)
+{
+	if (!m_enabled) {
+		return;
+	}
+
+	TraceEvent event;
+	event.name = name;
+	event.category = category;
+	event.phase = 'X';
+	event.timestampUs = startUs;
+	event.durationUs = endUs > startUs ? endUs - startUs : 0;
+	event.counter = counter;
+	event.value = value;
+
+	double durationMs = static_cast<double>(event.durationUs) / 1000.0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	event.threadId = getThreadId();
+	accumulate(m_frameCounters, counter, value, durationMs);
+	accumulate(m_totalCounters, counter, value, durationMs);
+	pushEvent(event);
+}
+
+void LibGFX::TraceRecorder::addInstant(const char* name, const char* category)
+{
+	if (!m_enabled) {
+		return;
+	}
+
+	TraceEvent event;
+	event.name = name;
+	event.category = category;
+	event.phase = 'i';
+	event.timestampUs = now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	event.threadId = getThreadId();
+	pushEvent(event);
+}
+
+void LibGFX::TraceRecorder::markFrame()
+{
+	if (!m_enabled) {
+		return;
+	}
+
+	uint64_t timestamp = now();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32_t threadId = getThreadId();
+	m_lastFrameCounters = m_frameCounters;
+	m_frameCounters = TraceCounters();
+	m_frameCount++;
+
+	// One counter track per value, sampled at the frame boundary
+	auto pushCounter = [&](const char* name, uint64_t value) {
+		TraceEvent event;
+		event.name = name;
+		event.category = "frame";
+		event.phase = 'C';
+		event.threadId = threadId;
+		event.timestampUs = timestamp;
+		event.value = value;
+		pushEvent(event);
+	};
+	pushCounter("allocations", m_lastFrameCounters.allocations);
+	pushCounter("submits", m_lastFrameCounters.submits);
+	pushCounter("queueDrains", m_lastFrameCounters.queueDrains);
+	pushCounter("fenceWaits", m_lastFrameCounters.fenceWaits);
+	pushCounter("uploadedBytes", m_lastFrameCounters.uploadedBytes);
+
+	TraceEvent frameEvent;
+	frameEvent.name = "frame";
+	frameEvent.category = "frame";
+	frameEvent.phase = 'i';
+	frameEvent.threadId = threadId;
+	frameEvent.timestampUs = timestamp;
+	pushEvent(frameEvent);
+}
+
+std::string LibGFX::TraceRecorder::toChromeTraceJson() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::ostringstream stream;
+	stream << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < m_events.size(); i++) {
+		const TraceEvent& event = m_events[i];
+		stream << "{\"name\":\"";
+		writeEscaped(stream, event.name);
+		stream << "\",\"cat\":\"";
+		writeEscaped(stream, event.category);
+		stream << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << event.threadId << ",\"ts\":" << event.timestampUs;
+		if (event.phase == 'X') {
+			stream << ",\"dur\":" << event.durationUs;
+			if (event.value > 0) {
+				stream << ",\"args\":{\"" << getCounterArgName(event.counter) << "\":" << event.value << "}";
+			}
+		}
+		else if (event.phase == 'C') {
+			stream << ",\"args\":{\"value\":" << event.value << "}";
+		}
+		else if (event.phase == 'i') {
+			stream << ",\"s\":\"t\"";
+		}
+		stream << "}" << (i + 1 < m_events.size() ? ",\n" : "\n");
+	}
+	stream << "],\"displayTimeUnit\":\"ms\"}\n";
+	return stream.str();
+}
+
+void LibGFX::TraceRecorder::writeChromeTrace(const std::string& filename) const
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open trace file: " + filename);
+	}
+	file << toChromeTraceJson();
+}
+
+LibGFX::TraceCounters LibGFX::TraceRecorder::getFrameCounters() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_lastFrameCounters;
+}
+
+LibGFX::TraceCounters LibGFX::TraceRecorder::getTotalCounters() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_totalCounters;
+}
+
+uint64_t LibGFX::TraceRecorder::getFrameCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frameCount;
+}
+
+size_t LibGFX::TraceRecorder::getEventCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_events.size();
+}
+
+size_t LibGFX::TraceRecorder::getDroppedEventCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_droppedEvents;
+}
+
+void LibGFX::TraceRecorder::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.clear();
+	m_droppedEvents = 0;
+	m_frameCount = 0;
+	m_frameCounters = TraceCounters();
+	m_lastFrameCounters = TraceCounters();
+	m_totalCounters = TraceCounters();
+}
+
+void LibGFX::TraceRecorder::pushEvent(const TraceEvent& event)
+{
+	// Counters keep running once the event buffer is full
+	if (m_events.size() >= m_maxEvents) {
+		m_droppedEvents++;
+		return;
+	}
+	m_events.push_back(event);
+}
+
+uint32_t LibGFX::TraceRecorder::getThreadId()
+{
+	auto result = m_threadIds.emplace(std::this_thread::get_id(), static_cast<uint32_t>(m_threadIds.size()) + 1);
+	return result.first->second;
+}
+
+void LibGFX::TraceRecorder::accumulate(TraceCounters& counters, TraceCounter counter, uint64_t value, double durationMs)
+{
+	switch (counter) {
+	case TraceCounter::Allocation:
+		counters.allocations++;
+		counters.allocatedBytes += value;
+		break;
+	case TraceCounter::Free:
+		counters.frees++;
+		break;
+	case TraceCounter::Submit:
+		counters.submits += static_cast<uint32_t>(value);
+		break;
+	case TraceCounter::QueueDrain:
+		counters.queueDrains++;
+		counters.drainMs += durationMs;
+		break;
+	case TraceCounter::FenceWait:
+		counters.fenceWaits++;
+		counters.fenceWaitMs += durationMs;
+		break;
+	case TraceCounter::Upload:
+		counters.uploadedBytes += value;
+		break;
+	default:
+		break;
+	}
+}
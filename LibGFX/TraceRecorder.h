@@ -0,0 +1,122 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+namespace LibGFX {
+
+	// Counter a traced event contributes to
+	enum class TraceCounter {
+		None,
+		Allocation,	// value = bytes
+		Free,
+		Submit,	// value = number of batches
+		QueueDrain,	// Helper blocked until the device or a queue ran dry
+		FenceWait,
+		Upload	// value = bytes written from the host
+	};
+
+	// Running totals, kept per frame and for the whole recording
+	struct TraceCounters {
+		uint32_t allocations = 0;
+		uint32_t frees = 0;
+		uint32_t submits = 0;
+		uint32_t queueDrains = 0;
+		uint32_t fenceWaits = 0;
+		VkDeviceSize allocatedBytes = 0;
+		VkDeviceSize uploadedBytes = 0;
+		double drainMs = 0.0;
+		double fenceWaitMs = 0.0;
+	};
+
+	// Records timed CPU events and exports them in the Chrome trace event format
+	// (chrome://tracing, ui.perfetto.dev). Event names and categories must be string literals.
+	class TraceRecorder
+	{
+	public:
+		static constexpr size_t DEFAULT_MAX_EVENTS = 1u << 20;
+
+		TraceRecorder(size_t maxEvents = DEFAULT_MAX_EVENTS);
+
+		void setEnabled(bool enabled) { m_enabled = enabled; }
+		bool isEnabled() const { return m_enabled; }
+
+		// Microseconds since the recorder was created
+		uint64_t now() const;
+		void addEvent(const char* name, const char* category, uint64_t startUs, uint64_t endUs, TraceCounter counter = TraceCounter::None, uint64_t value = 0);
+		void addInstant(const char* name, const char* category);
+
+		// Closes the counters of the current frame and emits them as counter events
+		void markFrame();
+		// Snapshots taken under the lock, other threads may be recording
+		TraceCounters getFrameCounters() const;
+		TraceCounters getTotalCounters() const;
+		uint64_t getFrameCount() const;
+		size_t getEventCount() const;
+		size_t getDroppedEventCount() const;
+
+		std::string toChromeTraceJson() const;
+		void writeChromeTrace(const std::string& filename) const;
+		void clear();
+	private:
+		struct TraceEvent {
+			const char* name = nullptr;
+			const char* category = nullptr;
+			char phase = 'X';
+			uint32_t threadId = 0;
+			uint64_t timestampUs = 0;
+			uint64_t durationUs = 0;
+			TraceCounter counter = TraceCounter::None;
+			uint64_t value = 0;
+		};
+
+		std::chrono::steady_clock::time_point m_startTime;
+		std::vector<TraceEvent> m_events;
+		std::unordered_map<std::thread::id, uint32_t> m_threadIds;
+		size_t m_maxEvents = 0;
+		size_t m_droppedEvents = 0;
+		uint64_t m_frameCount = 0;
+		TraceCounters m_frameCounters;
+		TraceCounters m_lastFrameCounters;
+		TraceCounters m_totalCounters;
+		std::atomic<bool> m_enabled{ true };
+		mutable std::mutex m_mutex;
+
+		void pushEvent(const TraceEvent& event);
+		uint32_t getThreadId();
+		static void accumulate(TraceCounters& counters, TraceCounter counter, uint64_t value, double durationMs);
+	};
+
+	// Records a complete event for its lifetime, does nothing if the recorder is null or disabled
+	class TraceScope
+	{
+	public:
+		TraceScope(TraceRecorder* recorder, const char* name, const char* category, TraceCounter counter = TraceCounter::None, uint64_t value = 0)
+			: m_recorder(recorder != nullptr && recorder->isEnabled() ? recorder : nullptr), m_name(name), m_category(category), m_counter(counter), m_value(value) {
+			if (m_recorder != nullptr) {
+				m_start = m_recorder->now();
+			}
+		}
+		~TraceScope() {
+			if (m_recorder != nullptr) {
+				m_recorder->addEvent(m_name, m_category, m_start, m_recorder->now(), m_counter, m_value);
+			}
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+		void setValue(uint64_t value) { m_value = value; }
+	private:
+		TraceRecorder* m_recorder;
+		const char* m_name;
+		const char* m_category;
+		TraceCounter m_counter;
+		uint64_t m_value;
+		uint64_t m_start = 0;
+	};
+}
@@ -0,0 +1,74 @@
+#include "UniformRing.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void LibGFX::UniformRing::create(VkContext& context, VkDeviceSize frameSize, uint32_t framesInFlight, VkBufferUsageFlags usage /*= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT*/)
+{
+	// Storage buffer usage has its own offset alignment, honor the stricter one
+	const VkPhysicalDeviceLimits& limits = context.getPhysicalDeviceProperties().limits;
+	m_alignment = limits.minUniformBufferOffsetAlignment;
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+		m_alignment = std::max(m_alignment, limits.minStorageBufferOffsetAlignment);
+	}
+
+	m_frameSize = ((frameSize + m_alignment - 1) / m_alignment) * m_alignment;
+	m_framesInFlight = framesInFlight;
+	m_buffer = context.createBuffer(
+		m_frameSize * framesInFlight,
+		usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	m_frameStart = 0;
+	m_head = 0;
+}
+
+void LibGFX::UniformRing::destroy(VkContext& context)
+{
+	if (m_buffer.buffer != VK_NULL_HANDLE) {
+		context.destroyBuffer(m_buffer);
+	}
+	m_frameSize = 0;
+	m_frameStart = 0;
+	m_head = 0;
+}
+
+void LibGFX::UniformRing::beginFrame(uint32_t frameIndex)
+{
+	// The frame's previous contents are no longer read once its fence has signaled
+	m_frameStart = static_cast<VkDeviceSize>(frameIndex % m_framesInFlight) * m_frameSize;
+	m_head = m_frameStart;
+}
+
+LibGFX::UniformAllocation LibGFX::UniformRing::allocate(VkDeviceSize size)
+{
+	VkDeviceSize alignedSize = ((size + m_alignment - 1) / m_alignment) * m_alignment;
+	if (m_head + alignedSize > m_frameStart + m_frameSize) {
+		throw std::runtime_error("UniformRing: frame region exhausted");
+	}
+
+	UniformAllocation allocation = {};
+	allocation.offset = m_head;
+	allocation.dynamicOffset = static_cast<uint32_t>(m_head);
+	allocation.data = static_cast<uint8_t*>(m_buffer.mapped) + m_head;
+
+	m_head += alignedSize;
+	return allocation;
+}
+
+LibGFX::UniformAllocation LibGFX::UniformRing::push(const void* data, VkDeviceSize size)
+{
+	UniformAllocation allocation = allocate(size);
+	memcpy(allocation.data, data, static_cast<size_t>(size));
+	return allocation;
+}
+
+VkDescriptorBufferInfo LibGFX::UniformRing::getDescriptorInfo(VkDeviceSize range) const
+{
+	// Dynamic descriptors use offset 0, the slice is selected by the dynamic offset at bind time
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = m_buffer.buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = range;
+	return bufferInfo;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Slice of the uniform ring handed out for the current frame
+	struct UniformAllocation {
+		void* data = nullptr;
+		VkDeviceSize offset = 0;
+		uint32_t dynamicOffset = 0;
+	};
+
+	// Linear allocator over one persistently mapped uniform buffer, split into one region per frame in flight.
+	// Slices are aligned to minUniformBufferOffsetAlignment and addressed with dynamic offsets.
+	class UniformRing
+	{
+	public:
+		void create(VkContext& context, VkDeviceSize frameSize, uint32_t framesInFlight, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+		void destroy(VkContext& context);
+
+		void beginFrame(uint32_t frameIndex);
+		UniformAllocation allocate(VkDeviceSize size);
+		UniformAllocation push(const void* data, VkDeviceSize size);
+
+		const Buffer& getBuffer() const { return m_buffer; }
+		VkDescriptorBufferInfo getDescriptorInfo(VkDeviceSize range) const;
+		VkDeviceSize getAlignment() const { return m_alignment; }
+		VkDeviceSize getFrameSize() const { return m_frameSize; }
+		VkDeviceSize getUsedBytes() const { return m_head - m_frameStart; }
+	private:
+		Buffer m_buffer = {};
+		VkDeviceSize m_alignment = 0;
+		VkDeviceSize m_frameSize = 0;
+		VkDeviceSize m_frameStart = 0;
+		VkDeviceSize m_head = 0;
+		uint32_t m_framesInFlight = 0;
+	};
+}
@@ -0,0 +1,551 @@
+#include "UploadContext.h"
+#include <cstring>
+#include <stdexcept>
+
+void LibGFX::UploadContext::create(VkContext& context, VkDeviceSize stagingChunkSize /*= DEFAULT_STAGING_CHUNK_SIZE*/)
+{
+	QueueFamilyIndices indices = context.getQueueFamilyIndices();
+	m_dedicatedTransfer = indices.hasDedicatedTransfer();
+	m_commandPool = context.createCommandPool(static_cast<uint32_t>(indices.transferFamily));
+	if (m_dedicatedTransfer) {
+		m_acquireCommandPool = context.createCommandPool(static_cast<uint32_t>(indices.graphicsFamily));
+	}
+	m_stagingChunkSize = stagingChunkSize;
+}
+
+void LibGFX::UploadContext::destroy(VkContext& context)
+{
+	// Discard a batch that was never submitted
+	if (isRecording()) {
+		context.endCommandBuffer(m_recording.commandBuffer);
+		if (m_recording.acquireCommandBuffer != VK_NULL_HANDLE) {
+			context.endCommandBuffer(m_recording.acquireCommandBuffer);
+		}
+		if (m_recording.releaseCommandBuffer != VK_NULL_HANDLE) {
+			context.endCommandBuffer(m_recording.releaseCommandBuffer);
+		}
+		releaseBatch(context, m_recording);
+		m_recording = UploadBatch();
+	}
+
+	for (auto& batch : m_inFlight) {
+		context.waitForFence(batch.fence);
+		releaseBatch(context, batch);
+	}
+	m_inFlight.clear();
+
+	for (auto& chunk : m_freeChunks) {
+		context.destroyBuffer(chunk);
+	}
+	m_freeChunks.clear();
+
+	context.destroyFences(m_freeFences);
+	m_freeFences.clear();
+
+	if (m_commandPool != VK_NULL_HANDLE) {
+		context.destroyCommandPool(m_commandPool);
+		m_commandPool = VK_NULL_HANDLE;
+	}
+	if (m_acquireCommandPool != VK_NULL_HANDLE) {
+		context.destroyCommandPool(m_acquireCommandPool);
+		m_acquireCommandPool = VK_NULL_HANDLE;
+	}
+}
+
+LibGFX::Image LibGFX::UploadContext::enqueueImage(VkContext& context, const ImageData& imageData, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/, bool generateMipmaps /*= false*/)
+{
+	beginBatch(context);
+
+	generateMipmaps = generateMipmaps && context.supportsLinearBlit(imageData.format);
+	uint32_t mipLevels = generateMipmaps ? getMipLevelCount(imageData.width, imageData.height) : imageData.mipLevels;
+	uint32_t uploadLevels = generateMipmaps ? 1 : imageData.mipLevels;
+	if (generateMipmaps) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	// Copy the pixels into the staging memory of this batch
+	VkDeviceSize imageSize = getStagingLevelOffset(imageData.width, imageData.height, imageData.format, uploadLevels);
+	StagingRange staging = allocateStaging(context, imageSize, getCopyAlignment(imageData.format));
+	packStagingLevels(static_cast<uint8_t*>(staging.data), imageData.pixels.data(), imageData.width, imageData.height, imageData.format, uploadLevels);
+
+	// Device local image
+	Image resultImage = {};
+	resultImage.image = context.createVkImage(
+		imageData.width,
+		imageData.height,
+		imageData.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&resultImage.allocation,
+		1,
+		0,
+		mipLevels);
+
+	// Mip generation happens after the acquire on the graphics queue
+	VkImageLayout releaseLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkCommandBuffer commandBuffer = m_recording.commandBuffer;
+	context.recordImageLayoutTransition(commandBuffer, resultImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, mipLevels);
+	context.recordCopyBufferToImage(commandBuffer, staging.buffer, resultImage.image, VkContext::getMipCopyRegions(staging.offset, imageData.width, imageData.height, imageData.format, uploadLevels));
+	context.recordImageRelease(commandBuffer, resultImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 1, mipLevels);
+	context.recordImageAcquire(getAcquireCommandBuffer(), resultImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 1, mipLevels);
+	if (generateMipmaps) {
+		context.recordGenerateMipmaps(getAcquireCommandBuffer(), resultImage.image, imageData.width, imageData.height, mipLevels);
+	}
+
+	resultImage.memory = resultImage.allocation.memory;
+	resultImage.imageView = context.createImageView(resultImage.image, imageData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, mipLevels);
+	resultImage.format = imageData.format;
+	resultImage.width = imageData.width;
+	resultImage.height = imageData.height;
+	resultImage.mipLevels = mipLevels;
+	return resultImage;
+}
+
+LibGFX::Image LibGFX::UploadContext::enqueueImageLevels(VkContext& context, const ImageData& imageData, uint32_t firstLevel, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/)
+{
+	if (firstLevel >= imageData.mipLevels) {
+		throw std::runtime_error("enqueueImageLevels: first level out of range");
+	}
+
+	beginBatch(context);
+
+	uint32_t width = getMipDimension(imageData.width, firstLevel);
+	uint32_t height = getMipDimension(imageData.height, firstLevel);
+	uint32_t mipLevels = imageData.mipLevels - firstLevel;
+
+	// The level chain from firstLevel on is a full chain of its own with firstLevel's size as level 0
+	VkDeviceSize srcOffset = imageData.getMipOffset(firstLevel);
+	VkDeviceSize imageSize = getStagingLevelOffset(width, height, imageData.format, mipLevels);
+	StagingRange staging = allocateStaging(context, imageSize, getCopyAlignment(imageData.format));
+	packStagingLevels(static_cast<uint8_t*>(staging.data), imageData.pixels.data() + srcOffset, width, height, imageData.format, mipLevels);
+
+	Image resultImage = {};
+	resultImage.image = context.createVkImage(
+		width,
+		height,
+		imageData.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&resultImage.allocation,
+		1,
+		0,
+		mipLevels);
+
+	VkCommandBuffer commandBuffer = m_recording.commandBuffer;
+	context.recordImageLayoutTransition(commandBuffer, resultImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, mipLevels);
+	context.recordCopyBufferToImage(commandBuffer, staging.buffer, resultImage.image, VkContext::getMipCopyRegions(staging.offset, width, height, imageData.format, mipLevels));
+	context.recordImageRelease(commandBuffer, resultImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, mipLevels);
+	context.recordImageAcquire(getAcquireCommandBuffer(), resultImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, mipLevels);
+
+	resultImage.memory = resultImage.allocation.memory;
+	resultImage.imageView = context.createImageView(resultImage.image, imageData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, mipLevels);
+	resultImage.format = imageData.format;
+	resultImage.width = width;
+	resultImage.height = height;
+	resultImage.mipLevels = mipLevels;
+	return resultImage;
+}
+
+void LibGFX::UploadContext::enqueueImageLayer(VkContext& context, VkImage image, uint32_t arrayLayers, uint32_t layer, const ImageData& imageData, bool newImage /*= false*/)
+{
+	if (layer >= arrayLayers) {
+		throw std::runtime_error("enqueueImageLayer: layer out of range");
+	}
+
+	beginBatch(context);
+
+	VkDeviceSize imageSize = getStagingLevelOffset(imageData.width, imageData.height, imageData.format, imageData.mipLevels);
+	StagingRange staging = allocateStaging(context, imageSize, getCopyAlignment(imageData.format));
+	packStagingLevels(static_cast<uint8_t*>(staging.data), imageData.pixels.data(), imageData.width, imageData.height, imageData.format, imageData.mipLevels);
+
+	// Only the target layer changes queue ownership, untouched layers of a fresh array are initialized at submit
+	if (newImage) {
+		ArrayInit arrayInit = {};
+		arrayInit.image = image;
+		arrayInit.mipLevels = imageData.mipLevels;
+		arrayInit.uploaded.resize(arrayLayers, false);
+		m_recording.arrayInits.push_back(arrayInit);
+	}
+	for (auto& arrayInit : m_recording.arrayInits) {
+		if (arrayInit.image == image) {
+			arrayInit.uploaded[layer] = true;
+		}
+	}
+
+	uint32_t mipLevels = imageData.mipLevels;
+	VkCommandBuffer commandBuffer = m_recording.commandBuffer;
+
+	// Waits on all earlier commands instead of TOP_OF_PIPE, the layer may have been transitioned earlier in this batch
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = layer;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+	context.recordCopyBufferToImage(commandBuffer, staging.buffer, image, VkContext::getMipCopyRegions(staging.offset, imageData.width, imageData.height, imageData.format, mipLevels, 1, 0, layer));
+	context.recordImageRelease(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, mipLevels, layer);
+	context.recordImageAcquire(getAcquireCommandBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, mipLevels, layer);
+}
+
+LibGFX::Cubemap LibGFX::UploadContext::enqueueCubemap(VkContext& context, const CubemapData& cubemapData, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/, bool generateMipmaps /*= false*/)
+{
+	beginBatch(context);
+
+	generateMipmaps = generateMipmaps && context.supportsLinearBlit(cubemapData.format);
+	uint32_t mipLevels = generateMipmaps ? getMipLevelCount(cubemapData.width, cubemapData.height) : cubemapData.mipLevels;
+	uint32_t uploadLevels = generateMipmaps ? 1 : cubemapData.mipLevels;
+	if (generateMipmaps) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	// Copy all faces back to back into the staging memory of this batch
+	VkDeviceSize layerSize = getStagingLevelOffset(cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels);
+	StagingRange staging = allocateStaging(context, layerSize * 6, getCopyAlignment(cubemapData.format));
+	for (int i = 0; i < 6; ++i) {
+		packStagingLevels(static_cast<uint8_t*>(staging.data) + layerSize * i, cubemapData.pixels[i].data(), cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels);
+	}
+
+	// Device local image
+	Cubemap resultCubemap = {};
+	resultCubemap.image = context.createVkImage(
+		cubemapData.width,
+		cubemapData.height,
+		cubemapData.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&resultCubemap.allocation,
+		6,
+		VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
+		mipLevels);
+
+	VkImageLayout releaseLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkCommandBuffer commandBuffer = m_recording.commandBuffer;
+	context.recordImageLayoutTransition(commandBuffer, resultCubemap.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6, mipLevels);
+	context.recordCopyBufferToImage(commandBuffer, staging.buffer, resultCubemap.image, VkContext::getMipCopyRegions(staging.offset, cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels, 6, layerSize));
+	context.recordImageRelease(commandBuffer, resultCubemap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 6, mipLevels);
+	context.recordImageAcquire(getAcquireCommandBuffer(), resultCubemap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 6, mipLevels);
+	if (generateMipmaps) {
+		context.recordGenerateMipmaps(getAcquireCommandBuffer(), resultCubemap.image, cubemapData.width, cubemapData.height, mipLevels, 6);
+	}
+
+	resultCubemap.memory = resultCubemap.allocation.memory;
+	resultCubemap.imageView = context.createImageView(resultCubemap.image, cubemapData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE, 6, mipLevels);
+	resultCubemap.format = cubemapData.format;
+	resultCubemap.width = cubemapData.width;
+	resultCubemap.height = cubemapData.height;
+	resultCubemap.mipLevels = mipLevels;
+	return resultCubemap;
+}
+
+void LibGFX::UploadContext::enqueueBuffer(VkContext& context, const Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset /*= 0*/)
+{
+	if (dstOffset + size > dstBuffer.size) {
+		throw std::runtime_error("enqueueBuffer: write out of bounds");
+	}
+
+	beginBatch(context);
+
+	StagingRange staging = allocateStaging(context, size);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+
+	// Graphics may still read or write the range, it is handed to the transfer queue before the copy
+	if (m_dedicatedTransfer) {
+		if (m_recording.releaseCommandBuffer == VK_NULL_HANDLE) {
+			m_recording.releaseCommandBuffer = context.allocateCommandBuffer(m_acquireCommandPool);
+			context.beginCommandBuffer(m_recording.releaseCommandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		}
+		context.recordBufferReleaseToTransfer(m_recording.releaseCommandBuffer, dstBuffer.buffer, dstOffset, size);
+	}
+	context.recordBufferAcquireForTransfer(m_recording.commandBuffer, dstBuffer.buffer, dstOffset, size);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(m_recording.commandBuffer, staging.buffer, dstBuffer.buffer, 1, &copyRegion);
+
+	// Ownership of the written range moves to the graphics queue, a shared queue uses the barrier in submit
+	if (m_dedicatedTransfer) {
+		context.recordBufferRelease(m_recording.commandBuffer, dstBuffer.buffer, dstOffset, size);
+		context.recordBufferAcquire(m_recording.acquireCommandBuffer, dstBuffer.buffer, dstOffset, size);
+	}
+}
+
+LibGFX::UploadTicket LibGFX::UploadContext::submit(VkContext& context)
+{
+	// Nothing recorded, ticket 0 is always complete
+	UploadTicket ticket = {};
+	if (!isRecording()) {
+		return ticket;
+	}
+
+	// Make all buffer copies of the batch visible to any later read
+	if (!m_dedicatedTransfer) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(
+			m_recording.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	recordArrayInits(context);
+	context.endCommandBuffer(m_recording.commandBuffer);
+
+	if (!m_freeFences.empty()) {
+		m_recording.fence = m_freeFences.back();
+		m_freeFences.pop_back();
+	}
+	else {
+		m_recording.fence = context.createFence();
+	}
+
+	if (m_dedicatedTransfer) {
+		// Copies on the transfer queue, the acquire barriers on the graphics queue wait for them
+		context.endCommandBuffer(m_recording.acquireCommandBuffer);
+		m_recording.transferComplete = context.createSemaphore();
+
+		// Buffer ranges written by the batch are released by graphics first
+		VkPipelineStageFlags releaseWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		if (m_recording.releaseCommandBuffer != VK_NULL_HANDLE) {
+			context.endCommandBuffer(m_recording.releaseCommandBuffer);
+			m_recording.graphicsReleased = context.createSemaphore();
+
+			VkSubmitInfo releaseSubmit = {};
+			releaseSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			releaseSubmit.commandBufferCount = 1;
+			releaseSubmit.pCommandBuffers = &m_recording.releaseCommandBuffer;
+			releaseSubmit.signalSemaphoreCount = 1;
+			releaseSubmit.pSignalSemaphores = &m_recording.graphicsReleased;
+			context.submitCommandBuffer(context.getGraphicsQueue(), releaseSubmit);
+		}
+
+		VkSubmitInfo transferSubmit = {};
+		transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (m_recording.graphicsReleased != VK_NULL_HANDLE) {
+			transferSubmit.waitSemaphoreCount = 1;
+			transferSubmit.pWaitSemaphores = &m_recording.graphicsReleased;
+			transferSubmit.pWaitDstStageMask = &releaseWaitStage;
+		}
+		transferSubmit.commandBufferCount = 1;
+		transferSubmit.pCommandBuffers = &m_recording.commandBuffer;
+		transferSubmit.signalSemaphoreCount = 1;
+		transferSubmit.pSignalSemaphores = &m_recording.transferComplete;
+		context.submitCommandBuffer(context.getTransferQueue(), transferSubmit);
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquireSubmit = {};
+		acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmit.waitSemaphoreCount = 1;
+		acquireSubmit.pWaitSemaphores = &m_recording.transferComplete;
+		acquireSubmit.pWaitDstStageMask = &waitStage;
+		acquireSubmit.commandBufferCount = 1;
+		acquireSubmit.pCommandBuffers = &m_recording.acquireCommandBuffer;
+		context.submitCommandBuffer(context.getGraphicsQueue(), acquireSubmit, m_recording.fence);
+	}
+	else {
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_recording.commandBuffer;
+		context.submitCommandBuffer(submitInfo, m_recording.fence);
+	}
+
+	ticket.id = m_recording.id;
+	m_inFlight.push_back(std::move(m_recording));
+	m_recording = UploadBatch();
+	return ticket;
+}
+
+bool LibGFX::UploadContext::isComplete(VkContext& context, UploadTicket ticket)
+{
+	collect(context);
+	if (isRecording() && m_recording.id == ticket.id) {
+		return false;
+	}
+	for (const auto& batch : m_inFlight) {
+		if (batch.id == ticket.id) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void LibGFX::UploadContext::wait(VkContext& context, UploadTicket ticket)
+{
+	if (isRecording() && m_recording.id == ticket.id) {
+		throw std::runtime_error("UploadContext: waiting on a batch that was not submitted");
+	}
+	for (const auto& batch : m_inFlight) {
+		if (batch.id == ticket.id) {
+			context.waitForFence(batch.fence);
+			break;
+		}
+	}
+	collect(context);
+}
+
+void LibGFX::UploadContext::collect(VkContext& context)
+{
+	for (auto it = m_inFlight.begin(); it != m_inFlight.end();) {
+		if (vkGetFenceStatus(context.getDevice(), it->fence) == VK_SUCCESS) {
+			releaseBatch(context, *it);
+			it = m_inFlight.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void LibGFX::UploadContext::beginBatch(VkContext& context)
+{
+	if (isRecording()) {
+		return;
+	}
+
+	m_recording.id = m_nextBatchId++;
+	m_recording.commandBuffer = context.allocateCommandBuffer(m_commandPool);
+	context.beginCommandBuffer(m_recording.commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	if (m_dedicatedTransfer) {
+		m_recording.acquireCommandBuffer = context.allocateCommandBuffer(m_acquireCommandPool);
+		context.beginCommandBuffer(m_recording.acquireCommandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	}
+}
+
+VkCommandBuffer LibGFX::UploadContext::getAcquireCommandBuffer() const
+{
+	return m_dedicatedTransfer ? m_recording.acquireCommandBuffer : m_recording.commandBuffer;
+}
+
+void LibGFX::UploadContext::recordArrayInits(VkContext& context)
+{
+	// The layers were never used by the transfer queue, a plain transition on the graphics side needs no ownership transfer
+	for (const auto& arrayInit : m_recording.arrayInits) {
+		uint32_t layerCount = static_cast<uint32_t>(arrayInit.uploaded.size());
+		uint32_t layer = 0;
+		while (layer < layerCount) {
+			if (arrayInit.uploaded[layer]) {
+				layer++;
+				continue;
+			}
+			uint32_t runStart = layer;
+			while (layer < layerCount && !arrayInit.uploaded[layer]) {
+				layer++;
+			}
+			context.recordImageLayoutTransition(getAcquireCommandBuffer(), arrayInit.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, layer - runStart, arrayInit.mipLevels, runStart);
+		}
+	}
+	m_recording.arrayInits.clear();
+}
+
+LibGFX::UploadContext::StagingRange LibGFX::UploadContext::allocateStaging(VkContext& context, VkDeviceSize size, VkDeviceSize alignment /*= 4*/)
+{
+	UploadBatch& batch = m_recording;
+	StagingRange range = {};
+
+	// Uploads larger than a chunk get their own staging buffer
+	if (size > m_stagingChunkSize) {
+		Buffer buffer = context.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		batch.stagingBuffers.push_back(buffer);
+
+		range.buffer = buffer.buffer;
+		range.offset = 0;
+		range.data = buffer.mapped;
+		return range;
+	}
+
+	// Image copies pass getCopyAlignment of their format, 3, 6 and 12 byte texels need more than a power of two
+	VkDeviceSize offset = alignUp(batch.chunkOffset, alignment);
+	if (batch.currentChunk < 0 || offset + size > m_stagingChunkSize) {
+		Buffer chunk;
+		if (!m_freeChunks.empty()) {
+			chunk = m_freeChunks.back();
+			m_freeChunks.pop_back();
+		}
+		else {
+			chunk = context.createBuffer(
+				m_stagingChunkSize,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		batch.stagingBuffers.push_back(chunk);
+		batch.currentChunk = static_cast<int>(batch.stagingBuffers.size() - 1);
+		offset = 0;
+	}
+
+	const Buffer& chunk = batch.stagingBuffers[batch.currentChunk];
+	batch.chunkOffset = offset + size;
+
+	range.buffer = chunk.buffer;
+	range.offset = offset;
+	range.data = static_cast<uint8_t*>(chunk.mapped) + offset;
+	return range;
+}
+
+void LibGFX::UploadContext::releaseBatch(VkContext& context, UploadBatch& batch)
+{
+	// Full sized chunks are recycled for later batches
+	for (auto& buffer : batch.stagingBuffers) {
+		if (buffer.size == m_stagingChunkSize) {
+			m_freeChunks.push_back(buffer);
+		}
+		else {
+			context.destroyBuffer(buffer);
+		}
+	}
+	batch.stagingBuffers.clear();
+
+	if (batch.fence != VK_NULL_HANDLE) {
+		context.resetFence(batch.fence);
+		m_freeFences.push_back(batch.fence);
+		batch.fence = VK_NULL_HANDLE;
+	}
+
+	if (batch.commandBuffer != VK_NULL_HANDLE) {
+		context.freeCommandBuffer(m_commandPool, batch.commandBuffer);
+		batch.commandBuffer = VK_NULL_HANDLE;
+	}
+	if (batch.acquireCommandBuffer != VK_NULL_HANDLE) {
+		context.freeCommandBuffer(m_acquireCommandPool, batch.acquireCommandBuffer);
+		batch.acquireCommandBuffer = VK_NULL_HANDLE;
+	}
+	if (batch.releaseCommandBuffer != VK_NULL_HANDLE) {
+		context.freeCommandBuffer(m_acquireCommandPool, batch.releaseCommandBuffer);
+		batch.releaseCommandBuffer = VK_NULL_HANDLE;
+	}
+	if (batch.transferComplete != VK_NULL_HANDLE) {
+		context.destroySemaphore(batch.transferComplete);
+		batch.transferComplete = VK_NULL_HANDLE;
+	}
+	if (batch.graphicsReleased != VK_NULL_HANDLE) {
+		context.destroySemaphore(batch.graphicsReleased);
+		batch.graphicsReleased = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+#include "VkContext.h"
+
+namespace LibGFX {
+
+	// Handle of a submitted upload batch that can be polled for completion
+	struct UploadTicket {
+		uint64_t id = 0;
+	};
+
+	// Records many buffer and image uploads into one command buffer and submits them at once.
+	// Copies run on the transfer queue when the device has one, the graphics queue acquires the resources afterwards.
+	// Staging memory of a batch is released only after the fence of its submission has signaled.
+	class UploadContext
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_STAGING_CHUNK_SIZE = 16ull * 1024 * 1024;
+
+		void create(VkContext& context, VkDeviceSize stagingChunkSize = DEFAULT_STAGING_CHUNK_SIZE);
+		void destroy(VkContext& context);
+
+		// The returned resources may be used once the ticket of the batch is complete
+		Image enqueueImage(VkContext& context, const ImageData& imageData, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, bool generateMipmaps = false);
+		// Uploads levels [firstLevel, mipLevels) of the data as an image whose level 0 is firstLevel, e.g. for texture streaming
+		Image enqueueImageLevels(VkContext& context, const ImageData& imageData, uint32_t firstLevel, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		// Uploads the levels of the data into one layer of an existing 2D array image with matching size, format and levels.
+		// Other layers keep their contents. With newImage the layers not uploaded in the same batch are moved from UNDEFINED
+		// to SHADER_READ_ONLY on the graphics queue at submit, so the whole array view has a defined layout.
+		void enqueueImageLayer(VkContext& context, VkImage image, uint32_t arrayLayers, uint32_t layer, const ImageData& imageData, bool newImage = false);
+		Cubemap enqueueCubemap(VkContext& context, const CubemapData& cubemapData, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, bool generateMipmaps = false);
+		// The copy waits for all graphics work submitted before the batch, with a dedicated transfer queue the range
+		// is released by a graphics submission the transfer submission waits on
+		void enqueueBuffer(VkContext& context, const Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		UploadTicket submit(VkContext& context);
+
+		bool isComplete(VkContext& context, UploadTicket ticket);
+		void wait(VkContext& context, UploadTicket ticket);
+		void collect(VkContext& context);
+		bool isRecording() const { return m_recording.commandBuffer != VK_NULL_HANDLE; }
+		size_t getPendingBatchCount() const { return m_inFlight.size(); }
+	private:
+		struct StagingRange {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			void* data = nullptr;
+		};
+
+		// Fresh array image, layers without an upload in the batch are initialized at submit
+		struct ArrayInit {
+			VkImage image = VK_NULL_HANDLE;
+			uint32_t mipLevels = 1;
+			std::vector<bool> uploaded;
+		};
+
+		struct UploadBatch {
+			uint64_t id = 0;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE; // Graphics queue side, only with a dedicated transfer queue
+			VkCommandBuffer releaseCommandBuffer = VK_NULL_HANDLE; // Graphics queue side ahead of the copies, only for buffer writes
+			VkSemaphore transferComplete = VK_NULL_HANDLE;
+			VkSemaphore graphicsReleased = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<Buffer> stagingBuffers;
+			std::vector<ArrayInit> arrayInits;
+			int currentChunk = -1;
+			VkDeviceSize chunkOffset = 0;
+		};
+
+		VkCommandPool m_commandPool = VK_NULL_HANDLE;
+		VkCommandPool m_acquireCommandPool = VK_NULL_HANDLE;
+		bool m_dedicatedTransfer = false;
+		VkDeviceSize m_stagingChunkSize = DEFAULT_STAGING_CHUNK_SIZE;
+		uint64_t m_nextBatchId = 1;
+		UploadBatch m_recording;
+		std::deque<UploadBatch> m_inFlight;
+		std::vector<Buffer> m_freeChunks;
+		std::vector<VkFence> m_freeFences;
+
+		void beginBatch(VkContext& context);
+		VkCommandBuffer getAcquireCommandBuffer() const;
+		void recordArrayInits(VkContext& context);
+		StagingRange allocateStaging(VkContext& context, VkDeviceSize size, VkDeviceSize alignment = 4);
+		void releaseBatch(VkContext& context, UploadBatch& batch);
+	};
+}
@@ -3,10 +3,61 @@
 #include <iostream>
 #include <array>
 #include <set>
+#include <functional>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 using namespace LibGFX;
 
-VkContext::VkContext(GLFWwindow* targetWindow)
+// Destination stage and access of the first use of an image in the given layout
+static void getLayoutAccessScope(VkImageLayout layout, VkPipelineStageFlags& stage, VkAccessFlags& access)
+{
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+		stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		access = 0;
+		break;
+	case VK_IMAGE_LAYOUT_GENERAL:
+		stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		break;
+	default:
+		throw std::runtime_error("Unsupported layout transition");
+	}
+}
+
+static bool isDepthLayout(VkImageLayout layout)
+{
+	return layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+}
+
+VkContext::VkContext(GLFWwindow* targetWindow /*= nullptr*/)
 {
 	m_targetWindow = targetWindow;
 }
@@ -16,14 +67,45 @@ LibGFX::VkContext::~VkContext()
 	m_targetWindow = nullptr;
 }
 
-VkImageView VkContext::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType /*= VK_IMAGE_VIEW_TYPE_2D*/, uint32_t layers /*= 1*/)
+VkImageView VkContext::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType /*= VK_IMAGE_VIEW_TYPE_2D*/, uint32_t layers /*= 1*/, uint32_t mipLevels /*= 1*/)
 {
-	return createImageView(m_device, image, format, aspectFlags, viewType, layers);
+	return createImageView(m_device, image, format, aspectFlags, viewType, layers, mipLevels);
 }
 
-VkImage VkContext::createVkImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers /* = 1*/, VkImageCreateFlags flags /*= 0*/)
+VkImage VkContext::createVkImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryAllocation* imageAllocation, uint32_t layers /* = 1*/, VkImageCreateFlags flags /*= 0*/, uint32_t mipLevels /*= 1*/)
 {
-	return createVkImage(m_physicalDevice, m_device, width, height, format, tiling, usage, properties, imageMemory, layers, flags);
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = layers;
+	imageInfo.format = format;
+	imageInfo.tiling = tiling;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.flags = flags;
+
+	VkImage image;
+	if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image");
+	}
+
+	// Sub-allocate memory for the image, the tiling lets the allocator honor bufferImageGranularity
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+	TraceScope traceScope(m_traceRecorder, "allocateImage", "memory", TraceCounter::Allocation, memRequirements.size);
+	// Transient attachments are backed by lazily allocated memory where the device offers it
+	VkMemoryPropertyFlags preferredProperties = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+	*imageAllocation = m_allocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, preferredProperties);
+	vkBindImageMemory(m_device, image, imageAllocation->memory, imageAllocation->offset);
+
+	return image;
 }
 
 void VkContext::destroyImage(Image& image)
@@ -39,7 +121,8 @@ void VkContext::destroyImage(Image& image)
 	}
 
 	if (image.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(m_device, image.memory, nullptr);
+		TraceScope traceScope(m_traceRecorder, "freeImage", "memory", TraceCounter::Free);
+		m_allocator.free(image.allocation);
 		image.memory = VK_NULL_HANDLE;
 	}
 }
@@ -57,58 +140,44 @@ void VkContext::destroyCubemap(Cubemap& cubemap)
 	}
 
 	if (cubemap.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(m_device, cubemap.memory, nullptr);
+		m_allocator.free(cubemap.allocation);
 		cubemap.memory = VK_NULL_HANDLE;
 	}
 }
 
 void VkContext::copyBufferToImage(VkCommandPool commandPool, const Buffer& srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
 {
-	VkCommandBuffer commandBuffer = allocateCommandBuffer(commandPool);
-	beginCommandBuffer(commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
-
-	vkCmdCopyBufferToImage(
-		commandBuffer,
-		srcBuffer.buffer,
-		dstImage,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&region);
-
-	endCommandBuffer(commandBuffer);
+	TraceScope traceScope(m_traceRecorder, "copyBufferToImage", "transfer");
 
-	// Submit the command buffer and wait for completion
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit buffer to image copy command buffer");
-	}
-	vkQueueWaitIdle(m_graphicsQueue);
-	freeCommandBuffer(commandPool, commandBuffer);
+	// The image stays in TRANSFER_DST, the copy overwrites it so the transfer queue needs no release of earlier contents
+	submitUpload(commandPool,
+		[&](VkCommandBuffer commandBuffer) {
+			recordCopyBufferToImage(commandBuffer, srcBuffer.buffer, 0, dstImage, width, height);
+			recordImageRelease(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageAcquire(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		});
 }
 
 void VkContext::copyBufferToImageArray(VkCommandPool commandPool, const Buffer& srcBuffer, VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount, VkDeviceSize layerSize)
 {
-	VkCommandBuffer commandBuffer = allocateCommandBuffer(commandPool);
-	beginCommandBuffer(commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	TraceScope traceScope(m_traceRecorder, "copyBufferToImageArray", "transfer");
+	submitUpload(commandPool,
+		[&](VkCommandBuffer commandBuffer) {
+			recordCopyBufferToImage(commandBuffer, srcBuffer.buffer, 0, dstImage, width, height, layerCount, layerSize);
+			recordImageRelease(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageAcquire(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount);
+		});
+}
 
+void VkContext::recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount /*= 1*/, VkDeviceSize layerSize /*= 0*/)
+{
 	std::vector<VkBufferImageCopy> regions(layerCount);
 	for (uint32_t i = 0; i < layerCount; ++i) {
-		regions[i].bufferOffset = i * layerSize;
+		regions[i].bufferOffset = srcOffset + i * layerSize;
 		regions[i].bufferRowLength = 0;
 		regions[i].bufferImageHeight = 0;
 		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -121,32 +190,65 @@ void VkContext::copyBufferToImageArray(VkCommandPool commandPool, const Buffer&
 
 	vkCmdCopyBufferToImage(
 		commandBuffer,
-		srcBuffer.buffer,
+		srcBuffer,
 		dstImage,
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 		static_cast<uint32_t>(regions.size()),
 		regions.data());
+}
 
-	endCommandBuffer(commandBuffer);
-
-	// Submit the command buffer and wait for completion
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+void VkContext::recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, const std::vector<VkBufferImageCopy>& regions)
+{
+	vkCmdCopyBufferToImage(
+		commandBuffer,
+		srcBuffer,
+		dstImage,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data());
+}
 
-	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit buffer to image copy command buffer");
+std::vector<VkBufferImageCopy> VkContext::getMipCopyRegions(VkDeviceSize srcOffset, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, uint32_t layerCount /*= 1*/, VkDeviceSize layerStride /*= 0*/, uint32_t baseArrayLayer /*= 0*/)
+{
+	// Levels of a layer follow getStagingLevelOffset, layers are layerStride apart
+	std::vector<VkBufferImageCopy> regions;
+	regions.reserve(static_cast<size_t>(mipLevels) * layerCount);
+	for (uint32_t layer = 0; layer < layerCount; ++layer) {
+		VkDeviceSize levelOffset = srcOffset + layer * layerStride;
+		for (uint32_t level = 0; level < mipLevels; ++level) {
+			VkBufferImageCopy region = {};
+			region.bufferOffset = levelOffset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = baseArrayLayer + layer;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { getMipDimension(width, level), getMipDimension(height, level), 1 };
+			regions.push_back(region);
+
+			levelOffset += alignUp(getMipLevelSize(width, height, format, level), getCopyAlignment(format));
+		}
 	}
-	vkQueueWaitIdle(m_graphicsQueue);
-	freeCommandBuffer(commandPool, commandBuffer);
+	return regions;
 }
 
-void VkContext::transitionImageLayout(VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount /*= 1*/)
+void VkContext::transitionImageLayout(VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount /*= 1*/, uint32_t mipLevels /*= 1*/)
 {
+	TraceScope traceScope(m_traceRecorder, "transitionImageLayout", "transfer");
 	VkCommandBuffer commandBuffer = allocateCommandBuffer(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	beginCommandBuffer(commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	recordImageLayoutTransition(commandBuffer, image, srcLayout, dstLayout, layerCount, mipLevels);
+	endCommandBuffer(commandBuffer);
 
+	// Submit the command buffer and wait for completion
+	submitImmediate(queue, commandBuffer);
+	freeCommandBuffer(commandPool, commandBuffer);
+}
+
+void VkContext::recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount /*= 1*/, uint32_t mipLevels /*= 1*/, uint32_t baseArrayLayer /*= 0*/, VkImageAspectFlags aspectMask /*= 0*/)
+{
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = srcLayout;
@@ -156,8 +258,8 @@ void VkContext::transitionImageLayout(VkQueue queue, VkCommandPool commandPool,
 	barrier.image = image;
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = baseArrayLayer;
 	barrier.subresourceRange.layerCount = layerCount;
 
 	VkPipelineStageFlags sourceStage;
@@ -177,6 +279,24 @@ void VkContext::transitionImageLayout(VkQueue queue, VkCommandPool commandPool,
 		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else {
+		// Attachment transitions for dynamic rendering and any other pair with a known access scope
+		getLayoutAccessScope(dstLayout, destinationStage, barrier.dstAccessMask);
+		if (srcLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			// Same stage as the destination so the barrier chains with a swapchain acquire semaphore
+			sourceStage = destinationStage;
+			barrier.srcAccessMask = 0;
+		}
+		else {
+			getLayoutAccessScope(srcLayout, sourceStage, barrier.srcAccessMask);
+		}
+		if (aspectMask == 0 && (isDepthLayout(srcLayout) || isDepthLayout(dstLayout))) {
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		}
+	}
+	if (aspectMask != 0) {
+		barrier.subresourceRange.aspectMask = aspectMask;
+	}
 
 	vkCmdPipelineBarrier(
 		commandBuffer,
@@ -185,26 +305,536 @@ void VkContext::transitionImageLayout(VkQueue queue, VkCommandPool commandPool,
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
+}
 
-	endCommandBuffer(commandBuffer);
+bool VkContext::supportsLinearBlit(VkFormat format)
+{
+	// Compressed formats can be filtered but not blitted into, their levels must come with the data
+	return isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
 
-	// Submit the command buffer and wait for completion
+void VkContext::recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount /*= 1*/)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.subresourceRange.levelCount = 1;
+
+	int32_t mipWidth = static_cast<int32_t>(width);
+	int32_t mipHeight = static_cast<int32_t>(height);
+
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		// Previous level becomes the blit source
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = layerCount;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = layerCount;
+
+		vkCmdBlitImage(
+			commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			VK_FILTER_LINEAR);
+
+		// Source level is done
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	// The last level was only written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void VkContext::recordImageRelease(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount /*= 1*/, uint32_t mipLevels /*= 1*/, uint32_t baseArrayLayer /*= 0*/)
+{
+	// Within one family the acquire side performs a plain transition
+	if (!m_queueFamilyIndices.hasDedicatedTransfer()) {
+		return;
+	}
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+	barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = baseArrayLayer;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void VkContext::recordImageAcquire(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount /*= 1*/, uint32_t mipLevels /*= 1*/, uint32_t baseArrayLayer /*= 0*/)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = baseArrayLayer;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkPipelineStageFlags destinationStage;
+	getLayoutAccessScope(newLayout, destinationStage, barrier.dstAccessMask);
+
+	// The release on the transfer queue already made the writes available
+	if (m_queueFamilyIndices.hasDedicatedTransfer()) {
+		barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+		barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+		barrier.srcAccessMask = 0;
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, destinationStage,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void VkContext::recordBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (!m_queueFamilyIndices.hasDedicatedTransfer()) {
+		return;
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+	barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (m_queueFamilyIndices.hasDedicatedTransfer()) {
+		barrier.srcAccessMask = 0;
+		barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+		barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordBufferReleaseToTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (!m_queueFamilyIndices.hasDedicatedTransfer()) {
+		return;
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+	barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordBufferAcquireForTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess /*= VK_ACCESS_TRANSFER_WRITE_BIT*/)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	// Earlier reads only need to finish, earlier writes must also be available before the copy writes
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (m_queueFamilyIndices.hasDedicatedTransfer()) {
+		barrier.srcAccessMask = 0;
+		barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+		barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transferFamily);
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordComputeBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset /*= 0*/, VkDeviceSize size /*= VK_WHOLE_SIZE*/)
+{
+	if (!m_queueFamilyIndices.hasDedicatedCompute()) {
+		return;
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.computeFamily);
+	barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordComputeBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset /*= 0*/, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkPipelineStageFlags dstStage /*= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT*/, VkAccessFlags dstAccess /*= VK_ACCESS_MEMORY_READ_BIT*/)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	// The release on the compute queue already made the writes available
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	if (m_queueFamilyIndices.hasDedicatedCompute()) {
+		barrier.srcAccessMask = 0;
+		barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.computeFamily);
+		barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, dstStage,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordGraphicsBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset /*= 0*/, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkPipelineStageFlags srcStage /*= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT*/)
+{
+	if (!m_queueFamilyIndices.hasDedicatedCompute()) {
+		return;
+	}
+
+	// Graphics only read the buffer, there are no writes to make available
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+	barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.computeFamily);
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordGraphicsBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset /*= 0*/, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkAccessFlags dstAccess /*= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT*/)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	// On a shared queue the earlier graphics reads only need to finish before the dispatch writes
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (m_queueFamilyIndices.hasDedicatedCompute()) {
+		barrier.srcQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphicsFamily);
+		barrier.dstQueueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.computeFamily);
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::recordBufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkDeviceSize offset /*= 0*/, VkDeviceSize size /*= VK_WHOLE_SIZE*/)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStage, dstStage,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void VkContext::submitUpload(VkCommandPool graphicsCommandPool, const std::function<void(VkCommandBuffer)>& recordTransfer, const std::function<void(VkCommandBuffer)>& recordGraphics, const std::function<void(VkCommandBuffer)>& recordRelease /*= nullptr*/)
+{
+	// Single family: record all parts into one command buffer
+	if (!m_queueFamilyIndices.hasDedicatedTransfer()) {
+		VkCommandBuffer commandBuffer = allocateCommandBuffer(graphicsCommandPool);
+		beginCommandBuffer(commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		if (recordRelease) {
+			recordRelease(commandBuffer);
+		}
+		recordTransfer(commandBuffer);
+		recordGraphics(commandBuffer);
+		endCommandBuffer(commandBuffer);
+
+		submitImmediate(m_graphicsQueue, commandBuffer);
+		freeCommandBuffer(graphicsCommandPool, commandBuffer);
+		return;
+	}
+
+	TraceScope traceScope(m_traceRecorder, "submitUpload", "stall");
+
+	VkCommandBuffer transferCommandBuffer = allocateCommandBuffer(m_transferCommandPool);
+	beginCommandBuffer(transferCommandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	recordTransfer(transferCommandBuffer);
+	endCommandBuffer(transferCommandBuffer);
+
+	VkCommandBuffer graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+	beginCommandBuffer(graphicsCommandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	recordGraphics(graphicsCommandBuffer);
+	endCommandBuffer(graphicsCommandBuffer);
+
+	// Optional graphics side release ahead of the transfer, the copy waits for it through a semaphore
+	VkCommandBuffer releaseCommandBuffer = VK_NULL_HANDLE;
+	VkSemaphore graphicsReleased = VK_NULL_HANDLE;
+	VkPipelineStageFlags releaseWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (recordRelease) {
+		releaseCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+		beginCommandBuffer(releaseCommandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		recordRelease(releaseCommandBuffer);
+		endCommandBuffer(releaseCommandBuffer);
+
+		graphicsReleased = createSemaphore();
+		VkSubmitInfo releaseSubmit = {};
+		releaseSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		releaseSubmit.commandBufferCount = 1;
+		releaseSubmit.pCommandBuffers = &releaseCommandBuffer;
+		releaseSubmit.signalSemaphoreCount = 1;
+		releaseSubmit.pSignalSemaphores = &graphicsReleased;
+		submitCommandBuffer(m_graphicsQueue, releaseSubmit);
+	}
+
+	// The graphics submission waits for the copy through a semaphore, the fence covers both
+	VkSemaphore transferComplete = createSemaphore();
+	VkSubmitInfo transferSubmit = {};
+	transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	if (graphicsReleased != VK_NULL_HANDLE) {
+		transferSubmit.waitSemaphoreCount = 1;
+		transferSubmit.pWaitSemaphores = &graphicsReleased;
+		transferSubmit.pWaitDstStageMask = &releaseWaitStage;
+	}
+	transferSubmit.commandBufferCount = 1;
+	transferSubmit.pCommandBuffers = &transferCommandBuffer;
+	transferSubmit.signalSemaphoreCount = 1;
+	transferSubmit.pSignalSemaphores = &transferComplete;
+	submitCommandBuffer(m_transferQueue, transferSubmit);
+
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkSubmitInfo graphicsSubmit = {};
+	graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	graphicsSubmit.waitSemaphoreCount = 1;
+	graphicsSubmit.pWaitSemaphores = &transferComplete;
+	graphicsSubmit.pWaitDstStageMask = &waitStage;
+	graphicsSubmit.commandBufferCount = 1;
+	graphicsSubmit.pCommandBuffers = &graphicsCommandBuffer;
+
+	VkFence fence = createFence();
+	submitCommandBuffer(m_graphicsQueue, graphicsSubmit, fence);
+	waitForFence(fence);
+
+	destroyFence(fence);
+	destroySemaphore(transferComplete);
+	freeCommandBuffer(m_transferCommandPool, transferCommandBuffer);
+	freeCommandBuffer(graphicsCommandPool, graphicsCommandBuffer);
+	if (releaseCommandBuffer != VK_NULL_HANDLE) {
+		destroySemaphore(graphicsReleased);
+		freeCommandBuffer(graphicsCommandPool, releaseCommandBuffer);
+	}
+}
+
+void VkContext::submitImmediate(VkQueue queue, VkCommandBuffer commandBuffer)
+{
+	// Not a queue drain, the fence wait below is counted by waitForFence
+	TraceScope traceScope(m_traceRecorder, "submitImmediate", "stall");
+
+	// Wait on a fence for this submission only instead of draining the whole queue
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit image layout transition command buffer");
+	VkFence fence = createFence();
+	VkResult result;
+	{
+		TraceScope submitScope(m_traceRecorder, "vkQueueSubmit", "submit", TraceCounter::Submit, 1);
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		result = vkQueueSubmit(queue, 1, &submitInfo, fence);
 	}
-	vkQueueWaitIdle(queue);
-	
-	freeCommandBuffer(commandPool, commandBuffer);
+	if (result != VK_SUCCESS) {
+		destroyFence(fence);
+		throw std::runtime_error("Failed to submit command buffer");
+	}
+	waitForFence(fence);
+	destroyFence(fence);
 }
 
-LibGFX::Image VkContext::createImage(const ImageData& imageData, VkCommandPool commandPool, VkImageUsageFlags usage)
+LibGFX::Image VkContext::createImage(const ImageData& imageData, VkCommandPool commandPool, VkImageUsageFlags usage, bool generateMipmaps /*= false*/)
 {
-	VkDeviceSize imageSize = imageData.getImageSize();
+	if ((usage & VK_IMAGE_USAGE_SAMPLED_BIT) && !isFormatSupported(imageData.format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		throw std::runtime_error("Failed to create image: format can not be sampled on this device");
+	}
+
+	// Blitting needs linear filter support, otherwise the image keeps the levels of the data
+	generateMipmaps = generateMipmaps && supportsLinearBlit(imageData.format);
+	uint32_t mipLevels = generateMipmaps ? getMipLevelCount(imageData.width, imageData.height) : imageData.mipLevels;
+	uint32_t uploadLevels = generateMipmaps ? 1 : imageData.mipLevels;
+	if (generateMipmaps) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	VkDeviceSize imageSize = getStagingLevelOffset(imageData.width, imageData.height, imageData.format, uploadLevels);
 
 	// Staging Buffer
 	Buffer stagingBuffer = createBuffer(
@@ -212,50 +842,70 @@ LibGFX::Image VkContext::createImage(const ImageData& imageData, VkCommandPool c
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	// Copy image data to staging buffer
-	updateBuffer(stagingBuffer, imageData.pixels.data(), imageSize);
+	// Copy image data to staging buffer, every level aligned for the copy
+	packStagingLevels(static_cast<uint8_t*>(stagingBuffer.mapped), imageData.pixels.data(), imageData.width, imageData.height, imageData.format, uploadLevels);
 
 	// Device Local image
-	VkDeviceMemory imageMemory;
+	MemoryAllocation imageAllocation;
 	VkImage image = createVkImage(
-		m_physicalDevice,
-		m_device,
 		imageData.width,
 		imageData.height,
 		imageData.format,
 		VK_IMAGE_TILING_OPTIMAL,
 		usage,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&imageMemory);
-
-	// Transition image layout and copy data from staging buffer
-	transitionImageLayout(m_graphicsQueue, commandPool, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-	// Copy buffer to image
-	copyBufferToImage(commandPool, stagingBuffer, image, imageData.width, imageData.height);
-
-	// Transition image to shader readable layout
-	transitionImageLayout(m_graphicsQueue, commandPool, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		&imageAllocation,
+		1,
+		0,
+		mipLevels);
+
+	// Copy on the transfer queue, the graphics queue takes ownership and blits the remaining levels if requested
+	VkImageLayout releaseLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	submitUpload(commandPool,
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageLayoutTransition(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, mipLevels);
+			recordCopyBufferToImage(commandBuffer, stagingBuffer.buffer, image, getMipCopyRegions(0, imageData.width, imageData.height, imageData.format, uploadLevels));
+			recordImageRelease(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 1, mipLevels);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageAcquire(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 1, mipLevels);
+			if (generateMipmaps) {
+				recordGenerateMipmaps(commandBuffer, image, imageData.width, imageData.height, mipLevels);
+			}
+		});
 
 	// Clean up staging buffer
 	destroyBuffer(stagingBuffer);
 	// Create image view
-	VkImageView imageView = createImageView(m_device, image, imageData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D);
+	VkImageView imageView = createImageView(m_device, image, imageData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, mipLevels);
 
 	// Return image struct
 	Image resultImage = {};
 	resultImage.image = image;
-	resultImage.memory = imageMemory;
+	resultImage.memory = imageAllocation.memory;
+	resultImage.allocation = imageAllocation;
 	resultImage.imageView = imageView;
 	resultImage.format = imageData.format;
 	resultImage.width = imageData.width;
 	resultImage.height = imageData.height;
+	resultImage.mipLevels = mipLevels;
 	return resultImage;
 }
 
-LibGFX::Cubemap VkContext::createCubemap(const CubemapData& cubemapData, VkCommandPool commandPool, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/)
+LibGFX::Cubemap VkContext::createCubemap(const CubemapData& cubemapData, VkCommandPool commandPool, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/, bool generateMipmaps /*= false*/)
 {
-	VkDeviceSize layerSize = cubemapData.getImageSize();
+	if ((usage & VK_IMAGE_USAGE_SAMPLED_BIT) && !isFormatSupported(cubemapData.format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		throw std::runtime_error("Failed to create cubemap: format can not be sampled on this device");
+	}
+
+	// Blitting needs linear filter support, otherwise the cubemap keeps the levels of the data
+	generateMipmaps = generateMipmaps && supportsLinearBlit(cubemapData.format);
+	uint32_t mipLevels = generateMipmaps ? getMipLevelCount(cubemapData.width, cubemapData.height) : cubemapData.mipLevels;
+	uint32_t uploadLevels = generateMipmaps ? 1 : cubemapData.mipLevels;
+	if (generateMipmaps) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	VkDeviceSize layerSize = getStagingLevelOffset(cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels);
 	VkDeviceSize imageSize = layerSize * 6;
 
 	// Staging Buffer
@@ -266,96 +916,84 @@ LibGFX::Cubemap VkContext::createCubemap(const CubemapData& cubemapData, VkComma
 
 	// Copy cubemap data to staging buffer
 	for (int i = 0; i < 6; ++i) {
-		updateBuffer(stagingBuffer, cubemapData.pixels[i].data(), layerSize, layerSize * i);
+		packStagingLevels(static_cast<uint8_t*>(stagingBuffer.mapped) + layerSize * i, cubemapData.pixels[i].data(), cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels);
 	}
 
 	// Device Local image
-	VkDeviceMemory imageMemory;
+	MemoryAllocation imageAllocation;
 	VkImage image = createVkImage(
-		m_physicalDevice,
-		m_device,
 		cubemapData.width,
 		cubemapData.height,
 		cubemapData.format,
 		VK_IMAGE_TILING_OPTIMAL,
 		usage,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&imageMemory,
+		&imageAllocation,
 		6,
-		VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
-
-	// Transition image layout and copy data from staging buffer
-	transitionImageLayout(m_graphicsQueue, commandPool, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6);
-
-	// Copy buffer to image
-	VkDeviceSize layerSizeBytes = cubemapData.getImageSize();
-	copyBufferToImageArray(commandPool, stagingBuffer, image, cubemapData.width, cubemapData.height, 6, layerSizeBytes);
-
-	// Transition image to shader readable layout
-	transitionImageLayout(m_graphicsQueue, commandPool, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 6);
+		VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
+		mipLevels);
+
+	// Copy all faces on the transfer queue, the graphics queue takes ownership and blits the remaining levels if requested
+	VkImageLayout releaseLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	submitUpload(commandPool,
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageLayoutTransition(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6, mipLevels);
+			recordCopyBufferToImage(commandBuffer, stagingBuffer.buffer, image, getMipCopyRegions(0, cubemapData.width, cubemapData.height, cubemapData.format, uploadLevels, 6, layerSize));
+			recordImageRelease(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 6, mipLevels);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordImageAcquire(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releaseLayout, 6, mipLevels);
+			if (generateMipmaps) {
+				recordGenerateMipmaps(commandBuffer, image, cubemapData.width, cubemapData.height, mipLevels, 6);
+			}
+		});
 
 	// Clean up staging buffer
 	destroyBuffer(stagingBuffer);
 
 	// Create image view
-	VkImageView imageView = createImageView(m_device, image, cubemapData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE, 6);
+	VkImageView imageView = createImageView(m_device, image, cubemapData.format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE, 6, mipLevels);
 
 	// Return cubemap struct
 	Cubemap resultCubemap = {};
 	resultCubemap.image = image;
-	resultCubemap.memory = imageMemory;
+	resultCubemap.memory = imageAllocation.memory;
+	resultCubemap.allocation = imageAllocation;
 	resultCubemap.imageView = imageView;
 	resultCubemap.format = cubemapData.format;
 	resultCubemap.width = cubemapData.width;
 	resultCubemap.height = cubemapData.height;
+	resultCubemap.mipLevels = mipLevels;
 	return resultCubemap;
 }
 
 void VkContext::copyBuffer(VkCommandPool commandPool, const Buffer& srcBuffer, const Buffer& dstBuffer, VkDeviceSize size)
 {
-	// Allocate a temporary command buffer for the copy operation
-	VkCommandBuffer commandBuffer = allocateCommandBuffer(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-
-	// Begin recording the command buffer
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to begin recording command buffer for buffer copy");
-	}
-
-	// Copy the buffer
-	VkBufferCopy copyRegion = {};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer.buffer, dstBuffer.buffer, 1, &copyRegion);
-
-
-	// End recording the command buffer
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to record command buffer for buffer copy");
-	}
-
-	// Submit the command buffer and wait for completion
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit buffer copy command buffer");
-	}
-	vkQueueWaitIdle(m_graphicsQueue);
-
-	// Free the temporary command buffer
-	freeCommandBuffer(commandPool, commandBuffer);
+	TraceScope traceScope(m_traceRecorder, "copyBuffer", "transfer");
+
+	// The source keeps its contents, graphics hands it to the transfer queue first; the destination goes to graphics afterwards
+	submitUpload(commandPool,
+		[&](VkCommandBuffer commandBuffer) {
+			recordBufferAcquireForTransfer(commandBuffer, srcBuffer.buffer, 0, size, VK_ACCESS_TRANSFER_READ_BIT);
+			VkBufferCopy copyRegion = {};
+			copyRegion.srcOffset = 0;
+			copyRegion.dstOffset = 0;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(commandBuffer, srcBuffer.buffer, dstBuffer.buffer, 1, &copyRegion);
+			recordBufferRelease(commandBuffer, dstBuffer.buffer, 0, size);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordBufferAcquire(commandBuffer, dstBuffer.buffer, 0, size);
+		},
+		[&](VkCommandBuffer commandBuffer) {
+			recordBufferReleaseToTransfer(commandBuffer, srcBuffer.buffer, 0, size);
+		});
 }
 
 void VkContext::resizeBuffer(VkCommandPool commandPool, Buffer& buffer, VkDeviceSize newSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
 {
-	vkDeviceWaitIdle(m_device);
+	TraceScope traceScope(m_traceRecorder, "resizeBuffer", "memory");
+	waitIdle();
 	Buffer newBuffer = createBuffer(newSize, usage, properties);
 	copyBuffer(commandPool, buffer, newBuffer, std::min(buffer.size, newSize));
 	destroyBuffer(buffer);
@@ -364,7 +1002,8 @@ void VkContext::resizeBuffer(VkCommandPool commandPool, Buffer& buffer, VkDevice
 
 void VkContext::recreateBuffer(Buffer& buffer, VkDeviceSize newSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
 {
-	vkDeviceWaitIdle(m_device);
+	TraceScope traceScope(m_traceRecorder, "recreateBuffer", "memory");
+	waitIdle();
 	Buffer newBuffer = createBuffer(newSize, usage, properties);
 	destroyBuffer(buffer);
 	buffer = newBuffer;
@@ -376,6 +1015,19 @@ void VkContext::freeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorS
 	descriptorSet = VK_NULL_HANDLE;
 }
 
+void VkContext::updateDescriptorSetWithTemplate(VkDescriptorSet descriptorSet, VkDescriptorUpdateTemplate updateTemplate, const void* data)
+{
+	vkUpdateDescriptorSetWithTemplate(m_device, descriptorSet, updateTemplate, data);
+}
+
+void VkContext::destroyDescriptorUpdateTemplate(VkDescriptorUpdateTemplate& updateTemplate)
+{
+	if (updateTemplate != VK_NULL_HANDLE) {
+		vkDestroyDescriptorUpdateTemplate(m_device, updateTemplate, nullptr);
+		updateTemplate = VK_NULL_HANDLE;
+	}
+}
+
 VkDescriptorSet VkContext::allocateDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout)
 {
 	VkDescriptorSetAllocateInfo allocInfo = {};
@@ -397,26 +1049,44 @@ void VkContext::updateBuffer(const Buffer& buffer, const void* data, VkDeviceSiz
 		throw std::runtime_error("updateBuffer: write out of bounds");
 	}
 
-	void* mappedData;
-	VkResult result = vkMapMemory(m_device, buffer.memory, offset, size, 0, &mappedData);
-	if (result != VK_SUCCESS) {
-		throw std::runtime_error("Failed to map buffer memory");
+	// Host visible buffers stay mapped for their whole lifetime
+	if (buffer.mapped == nullptr) {
+		throw std::runtime_error("updateBuffer: buffer memory is not host visible");
+	}
+
+	TraceScope traceScope(m_traceRecorder, "updateBuffer", "upload", TraceCounter::Upload, size);
+	memcpy(static_cast<uint8_t*>(buffer.mapped) + offset, data, static_cast<size_t>(size));
+	flushBuffer(buffer, size, offset);
+}
+
+void VkContext::flushBuffer(const Buffer& buffer, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/)
+{
+	if (size == VK_WHOLE_SIZE) {
+		size = buffer.size - offset;
 	}
+	m_allocator.flush(buffer.allocation, offset, size);
+}
 
-	memcpy(mappedData, data, static_cast<size_t>(size));
-	vkUnmapMemory(m_device, buffer.memory);
+void VkContext::invalidateBuffer(const Buffer& buffer, VkDeviceSize size /*= VK_WHOLE_SIZE*/, VkDeviceSize offset /*= 0*/)
+{
+	if (size == VK_WHOLE_SIZE) {
+		size = buffer.size - offset;
+	}
+	m_allocator.invalidate(buffer.allocation, offset, size);
 }
 
 void VkContext::destroyBuffer(Buffer& buffer)
 {
+	TraceScope traceScope(m_traceRecorder, "destroyBuffer", "memory", TraceCounter::Free);
 	vkDestroyBuffer(m_device, buffer.buffer, nullptr);
-	vkFreeMemory(m_device, buffer.memory, nullptr);
+	m_allocator.free(buffer.allocation);
 	buffer.buffer = VK_NULL_HANDLE;
 	buffer.memory = VK_NULL_HANDLE;
+	buffer.mapped = nullptr;
 	buffer.size = 0;
 }
 
-LibGFX::Buffer VkContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+LibGFX::Buffer VkContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties /*= 0*/)
 {
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -424,6 +1094,11 @@ LibGFX::Buffer VkContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usa
 	bufferInfo.usage = usage;
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+	// Descriptor buffers reference uniform and storage buffers by address
+	if (m_descriptorBuffer && (usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))) {
+		bufferInfo.usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	}
+
 	Buffer buffer = {};
 	if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create buffer");
@@ -432,33 +1107,95 @@ LibGFX::Buffer VkContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usa
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(m_device, buffer.buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memRequirements.memoryTypeBits, properties);
+	TraceScope traceScope(m_traceRecorder, "allocateBuffer", "memory", TraceCounter::Allocation, memRequirements.size);
+	buffer.allocation = m_allocator.allocate(memRequirements, properties, true, preferredProperties);
+	buffer.memory = buffer.allocation.memory;
+	buffer.mapped = buffer.allocation.mappedData;
+
+	vkBindBufferMemory(m_device, buffer.buffer, buffer.memory, buffer.allocation.offset);
+	buffer.size = size;
+
+	return buffer;
+}
+
+void VkContext::waitIdle()
+{
+	TraceScope traceScope(m_traceRecorder, "vkDeviceWaitIdle", "stall", TraceCounter::QueueDrain);
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	vkDeviceWaitIdle(m_device);
+}
+
+void VkContext::queuePresent(const VkPresentInfoKHR& presentInfo)
+{
+	this->queuePresent(m_presentQueue, presentInfo);
+}
+
+VkResult VkContext::tryQueuePresent(const VkPresentInfoKHR& presentInfo)
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	return vkQueuePresentKHR(m_presentQueue, &presentInfo);
+}
+
+VkResult VkContext::waitForPresent(VkSwapchainKHR swapchain, uint64_t presentId, uint64_t timeout)
+{
+	if (!m_presentWait) {
+		throw std::runtime_error("Present wait is not supported");
+	}
+	return m_vkWaitForPresentKHR(m_device, swapchain, presentId, timeout);
+}
+
+VkDeviceAddress VkContext::getBufferDeviceAddress(const Buffer& buffer) const
+{
+	if (m_vkGetBufferDeviceAddress == nullptr) {
+		throw std::runtime_error("Buffer device addresses are not supported");
+	}
+	VkBufferDeviceAddressInfo addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.buffer = buffer.buffer;
+	return m_vkGetBufferDeviceAddress(m_device, &addressInfo);
+}
 
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate buffer memory");
+VkDeviceSize VkContext::getDescriptorSetLayoutSize(VkDescriptorSetLayout layout) const
+{
+	if (!m_descriptorBuffer) {
+		throw std::runtime_error("Descriptor buffers are not supported");
 	}
+	VkDeviceSize size = 0;
+	m_vkGetDescriptorSetLayoutSizeEXT(m_device, layout, &size);
+	return size;
+}
 
-	vkBindBufferMemory(m_device, buffer.buffer, buffer.memory, 0);
-	buffer.size = size;
+VkDeviceSize VkContext::getDescriptorSetLayoutBindingOffset(VkDescriptorSetLayout layout, uint32_t binding) const
+{
+	if (!m_descriptorBuffer) {
+		throw std::runtime_error("Descriptor buffers are not supported");
+	}
+	VkDeviceSize offset = 0;
+	m_vkGetDescriptorSetLayoutBindingOffsetEXT(m_device, layout, binding, &offset);
+	return offset;
+}
 
-	return buffer;
+void VkContext::getDescriptor(const VkDescriptorGetInfoEXT& getInfo, size_t descriptorSize, void* descriptor) const
+{
+	if (!m_descriptorBuffer) {
+		throw std::runtime_error("Descriptor buffers are not supported");
+	}
+	m_vkGetDescriptorEXT(m_device, &getInfo, descriptorSize, descriptor);
 }
 
-void VkContext::waitIdle()
+void VkContext::bindDescriptorBuffers(VkCommandBuffer commandBuffer, uint32_t bufferCount, const VkDescriptorBufferBindingInfoEXT* bindingInfos)
 {
-	vkDeviceWaitIdle(m_device);
+	m_vkCmdBindDescriptorBuffersEXT(commandBuffer, bufferCount, bindingInfos);
 }
 
-void VkContext::queuePresent(const VkPresentInfoKHR& presentInfo)
+void VkContext::setDescriptorBufferOffsets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet, uint32_t setCount, const uint32_t* bufferIndices, const VkDeviceSize* offsets)
 {
-	this->queuePresent(m_presentQueue, presentInfo);
+	m_vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, bindPoint, pipelineLayout, firstSet, setCount, bufferIndices, offsets);
 }
 
 void VkContext::queuePresent(VkQueue presentQueue, const VkPresentInfoKHR& presentInfo)
 {
+	std::lock_guard<std::mutex> lock(m_queueMutex);
 	if (vkQueuePresentKHR(presentQueue, &presentInfo) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to present image");
 	}
@@ -466,6 +1203,8 @@ void VkContext::queuePresent(VkQueue presentQueue, const VkPresentInfoKHR& prese
 
 void VkContext::submitCommandBuffers(const std::vector<VkSubmitInfo>& submitInfos, VkFence fence /*= VK_NULL_HANDLE*/)
 {
+	TraceScope traceScope(m_traceRecorder, "vkQueueSubmit", "submit", TraceCounter::Submit, submitInfos.size());
+	std::lock_guard<std::mutex> lock(m_queueMutex);
 	if (vkQueueSubmit(m_graphicsQueue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit command buffers");
 	}
@@ -473,7 +1212,14 @@ void VkContext::submitCommandBuffers(const std::vector<VkSubmitInfo>& submitInfo
 
 void VkContext::submitCommandBuffer(const VkSubmitInfo& submitInfo, VkFence fence /*= VK_NULL_HANDLE*/)
 {
-	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+	this->submitCommandBuffer(m_graphicsQueue, submitInfo, fence);
+}
+
+void VkContext::submitCommandBuffer(VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence /*= VK_NULL_HANDLE*/)
+{
+	TraceScope traceScope(m_traceRecorder, "vkQueueSubmit", "submit", TraceCounter::Submit, 1);
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit command buffer");
 	}
 }
@@ -490,11 +1236,78 @@ void VkContext::endRenderPass(VkCommandBuffer commandBuffer)
 	vkCmdEndRenderPass(commandBuffer);
 }
 
+void VkContext::beginRendering(VkCommandBuffer commandBuffer, VkExtent2D extent, const std::vector<RenderingAttachment>& colorAttachments, const RenderingAttachment* depthAttachment /*= nullptr*/, VkRenderingFlags flags /*= 0*/)
+{
+	if (!m_dynamicRendering) {
+		throw std::runtime_error("Failed to begin rendering: dynamic rendering is not supported");
+	}
+
+	auto toAttachmentInfo = [](const RenderingAttachment& attachment) {
+		VkRenderingAttachmentInfo attachmentInfo = {};
+		attachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		attachmentInfo.imageView = attachment.imageView;
+		attachmentInfo.imageLayout = attachment.imageLayout;
+		attachmentInfo.resolveMode = attachment.resolveMode;
+		attachmentInfo.resolveImageView = attachment.resolveImageView;
+		attachmentInfo.resolveImageLayout = attachment.resolveImageLayout;
+		attachmentInfo.loadOp = attachment.loadOp;
+		attachmentInfo.storeOp = attachment.storeOp;
+		attachmentInfo.clearValue = attachment.clearValue;
+		return attachmentInfo;
+	};
+
+	if (colorAttachments.size() > m_physicalDeviceProperties.limits.maxColorAttachments) {
+		throw std::runtime_error("Failed to begin rendering: more color attachments than maxColorAttachments");
+	}
+	std::vector<VkRenderingAttachmentInfo> colorInfos(colorAttachments.size());
+	for (size_t i = 0; i < colorAttachments.size(); i++) {
+		colorInfos[i] = toAttachmentInfo(colorAttachments[i]);
+	}
+
+	VkRenderingAttachmentInfo depthInfo = {};
+	VkRenderingInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderingInfo.flags = flags;
+	renderingInfo.renderArea.offset = { 0, 0 };
+	renderingInfo.renderArea.extent = extent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+	renderingInfo.pColorAttachments = colorInfos.data();
+	if (depthAttachment != nullptr) {
+		// Without a format the attachment is taken as depth only
+		depthInfo = toAttachmentInfo(*depthAttachment);
+		VkImageAspectFlags aspect = getDepthAspect(depthAttachment->format);
+		if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+			renderingInfo.pDepthAttachment = &depthInfo;
+		}
+		if (aspect & VK_IMAGE_ASPECT_STENCIL_BIT) {
+			renderingInfo.pStencilAttachment = &depthInfo;
+		}
+	}
+
+	m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void VkContext::endRendering(VkCommandBuffer commandBuffer)
+{
+	m_vkCmdEndRendering(commandBuffer);
+}
+
 void VkContext::bindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, const Pipeline& pipeline)
 {
 	vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline.getPipeline());
 }
 
+void VkContext::dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY /*= 1*/, uint32_t groupCountZ /*= 1*/)
+{
+	vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void VkContext::dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset /*= 0*/)
+{
+	vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
 void VkContext::beginRenderPass(VkCommandBuffer commandBuffer, const RenderPass& renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkSubpassContents contents)
 {
 	VkRenderPassBeginInfo beginInfo = {};
@@ -541,6 +1354,7 @@ VkResult VkContext::acquireNextImage(const SwapchainInfo& swapchainInfo, VkSemap
 
 void VkContext::waitForFence(VkFence fence, uint64_t timeout /*= std::numeric_limits<uint64_t>::max()*/)
 {
+	TraceScope traceScope(m_traceRecorder, "waitForFence", "wait", TraceCounter::FenceWait);
 	vkWaitForFences(m_device, 1, &fence, VK_TRUE, timeout);
 }
 
@@ -627,7 +1441,7 @@ void VkContext::destroyDescriptorSetPool(VkDescriptorPool& descriptorPool)
 	vkDestroyDescriptorPool(m_device, descriptorPool, nullptr);
 }
 
-VkSampler VkContext::createCubeMapSampler(bool enableAnisotropy, float maxAnisotropy)
+VkSampler VkContext::createCubeMapSampler(bool enableAnisotropy, float maxAnisotropy, uint32_t mipLevels /*= 1*/)
 {
 	VkSamplerCreateInfo samplerInfo = {};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -641,7 +1455,7 @@ VkSampler VkContext::createCubeMapSampler(bool enableAnisotropy, float maxAnisot
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(mipLevels - 1);
 	if (!enableAnisotropy) {
 		samplerInfo.anisotropyEnable = VK_FALSE;
 		samplerInfo.maxAnisotropy = 1.0f;
@@ -655,7 +1469,7 @@ VkSampler VkContext::createCubeMapSampler(bool enableAnisotropy, float maxAnisot
 	return createSampler(samplerInfo);
 }
 
-VkSampler VkContext::createTextureSampler(bool enableAnisotropy, float maxAnisotropy)
+VkSampler VkContext::createTextureSampler(bool enableAnisotropy, float maxAnisotropy, uint32_t mipLevels /*= 1*/)
 {
 	VkSamplerCreateInfo samplerInfo = {};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -669,7 +1483,7 @@ VkSampler VkContext::createTextureSampler(bool enableAnisotropy, float maxAnisot
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(mipLevels - 1);
 	if (!enableAnisotropy) {
 		samplerInfo.anisotropyEnable = VK_FALSE;
 		samplerInfo.maxAnisotropy = 1.0f;
@@ -830,6 +1644,190 @@ VkFramebuffer VkContext::createFramebuffer(RenderPass& renderPass, VkImageView i
 	return framebuffer;
 }
 
+VkPipeline VkContext::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo)
+{
+	// Chain the creation feedback in front of whatever the caller already chained
+	VkPipelineCreationFeedbackEXT pipelineFeedback = {};
+	std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(createInfo.stageCount);
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {};
+	feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackInfo.pNext = createInfo.pNext;
+	feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	feedbackInfo.pipelineStageCreationFeedbackCount = createInfo.stageCount;
+	feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = createInfo;
+	if (m_pipelineCreationFeedback) {
+		pipelineInfo.pNext = &feedbackInfo;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create graphics pipeline");
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	recordPipelineCreation(std::chrono::duration<double, std::milli>(end - start).count(), pipelineFeedback);
+	return pipeline;
+}
+
+VkPipeline VkContext::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, const RenderingFormats& renderingFormats)
+{
+	if (!m_dynamicRendering) {
+		throw std::runtime_error("Failed to create graphics pipeline: dynamic rendering is not supported");
+	}
+
+	// The attachment formats take the place of the render pass
+	VkPipelineRenderingCreateInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.pNext = createInfo.pNext;
+	renderingInfo.viewMask = renderingFormats.viewMask;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(renderingFormats.colorFormats.size());
+	renderingInfo.pColorAttachmentFormats = renderingFormats.colorFormats.data();
+	renderingInfo.depthAttachmentFormat = renderingFormats.depthFormat;
+	renderingInfo.stencilAttachmentFormat = renderingFormats.stencilFormat;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = createInfo;
+	pipelineInfo.pNext = &renderingInfo;
+	pipelineInfo.renderPass = VK_NULL_HANDLE;
+	pipelineInfo.subpass = 0;
+	return createGraphicsPipeline(pipelineInfo);
+}
+
+VkPipeline VkContext::createComputePipeline(const VkComputePipelineCreateInfo& createInfo)
+{
+	VkPipelineCreationFeedbackEXT pipelineFeedback = {};
+	VkPipelineCreationFeedbackEXT stageFeedback = {};
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {};
+	feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackInfo.pNext = createInfo.pNext;
+	feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	feedbackInfo.pipelineStageCreationFeedbackCount = 1;
+	feedbackInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+
+	VkComputePipelineCreateInfo pipelineInfo = createInfo;
+	if (m_pipelineCreationFeedback) {
+		pipelineInfo.pNext = &feedbackInfo;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	recordPipelineCreation(std::chrono::duration<double, std::milli>(end - start).count(), pipelineFeedback);
+	return pipeline;
+}
+
+void VkContext::destroyPipeline(VkPipeline& pipeline)
+{
+	if (pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(m_device, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+}
+
+bool VkContext::loadPipelineCache(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> data(fileSize);
+	file.seekg(0);
+	file.read(data.data(), fileSize);
+	file.close();
+
+	// Caches of another driver or device are discarded, the current cache stays in use
+	if (!isPipelineCacheCompatible(data)) {
+		std::cout << "Discarding stale pipeline cache " << filename << std::endl;
+		return false;
+	}
+
+	// The driver may still reject the blob, keep the current cache until the new one exists
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	if (createPipelineCache(data.data(), data.size(), &pipelineCache) != VK_SUCCESS) {
+		std::cout << "Discarding rejected pipeline cache " << filename << std::endl;
+		return false;
+	}
+	if (m_pipelineCache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+	}
+	m_pipelineCache = pipelineCache;
+
+	m_pipelineCacheStats.loadedFromDisk = true;
+	m_pipelineCacheStats.loadedBytes = data.size();
+	return true;
+}
+
+void VkContext::savePipelineCache(const std::string& filename)
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to get pipeline cache size");
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to get pipeline cache data");
+	}
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file: " + filename);
+	}
+	file.write(data.data(), static_cast<std::streamsize>(dataSize));
+	file.close();
+}
+
+VkResult VkContext::createPipelineCache(const void* initialData, size_t initialDataSize, VkPipelineCache* pipelineCache)
+{
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialDataSize;
+	cacheInfo.pInitialData = initialData;
+	return vkCreatePipelineCache(m_device, &cacheInfo, nullptr, pipelineCache);
+}
+
+bool VkContext::isPipelineCacheCompatible(const std::vector<char>& data) const
+{
+	// Header layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	VkPipelineCacheHeaderVersionOne header = {};
+	if (data.size() < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header)
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == m_physicalDeviceProperties.vendorID
+		&& header.deviceID == m_physicalDeviceProperties.deviceID
+		&& memcmp(header.pipelineCacheUUID, m_physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void VkContext::recordPipelineCreation(double createMs, const VkPipelineCreationFeedbackEXT& feedback)
+{
+	m_pipelineCacheStats.pipelineCount++;
+	m_pipelineCacheStats.totalCreateMs += createMs;
+
+	if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+		m_pipelineCacheStats.unknownCount++;
+	}
+	else if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+		m_pipelineCacheStats.cacheHits++;
+		m_pipelineCacheStats.hitCreateMs += createMs;
+	}
+	else {
+		m_pipelineCacheStats.cacheMisses++;
+		m_pipelineCacheStats.missCreateMs += createMs;
+	}
+}
+
 void VkContext::destroyShaderModule(VkShaderModule shaderModule)
 {
 	vkDestroyShaderModule(m_device, shaderModule, nullptr);
@@ -878,7 +1876,8 @@ void VkContext::destroyDepthBuffer(DepthBuffer& depthBuffer)
 {
 	vkDestroyImageView(m_device, depthBuffer.imageView, nullptr);
 	vkDestroyImage(m_device, depthBuffer.image, nullptr);
-	vkFreeMemory(m_device, depthBuffer.memory, nullptr);
+	m_allocator.free(depthBuffer.allocation);
+	depthBuffer.memory = VK_NULL_HANDLE;
 }
 
 VkFormat VkContext::findSuitableDepthFormat()
@@ -890,22 +1889,49 @@ VkFormat VkContext::findSuitableDepthFormat()
 	return format;
 }
 
+VkFormat VkContext::findSuitableDepthFormat(DepthPrecision precision, bool stencil /*= false*/)
+{
+	// Requested size first, then the closest fallback
+	std::vector<VkFormat> candidates;
+	if (precision == DepthPrecision::D16) {
+		candidates = stencil
+			? std::vector<VkFormat>{ VK_FORMAT_D16_UNORM_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT }
+			: std::vector<VkFormat>{ VK_FORMAT_D16_UNORM, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D32_SFLOAT };
+	}
+	else {
+		candidates = stencil
+			? std::vector<VkFormat>{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }
+			: std::vector<VkFormat>{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+	}
+	return selectSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
 VkFormat VkContext::selectSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
 {
 	for (VkFormat format : candidates) {
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &props);
-
-		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-			return format;
-		}
-		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+		if (isFormatSupported(format, tiling, features)) {
 			return format;
 		}
 	}
 	return VK_FORMAT_UNDEFINED;
 }
 
+bool VkContext::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &props);
+
+	if (tiling == VK_IMAGE_TILING_LINEAR) {
+		return (props.linearTilingFeatures & features) == features;
+	}
+	return (props.optimalTilingFeatures & features) == features;
+}
+
+VkFormat VkContext::selectTextureFormat(const std::vector<VkFormat>& candidates)
+{
+	return selectSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
 uint32_t VkContext::findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memProperties;
@@ -919,7 +1945,7 @@ uint32_t VkContext::findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typ
 	throw std::runtime_error("Failed to find suitable memory type");
 }
 
-VkImage VkContext::createVkImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers /*= 1*/, VkImageCreateFlags flags /*= 0*/)
+VkImage VkContext::createVkImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers /*= 1*/, VkImageCreateFlags flags /*= 0*/, uint32_t mipLevels /*= 1*/)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -927,7 +1953,7 @@ VkImage VkContext::createVkImage(VkPhysicalDevice physicalDevice, VkDevice devic
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = layers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
@@ -960,38 +1986,70 @@ VkImage VkContext::createVkImage(VkPhysicalDevice physicalDevice, VkDevice devic
 	return image;
 }
 
-LibGFX::DepthBuffer VkContext::createDepthBuffer(VkExtent2D extent, VkFormat format)
+LibGFX::Image VkContext::createRenderTarget(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage /*= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT*/)
+{
+	// Offscreen color image, stays in UNDEFINED layout until the first render pass
+	Image resultImage = {};
+	resultImage.image = createVkImage(
+		width,
+		height,
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&resultImage.allocation);
+	resultImage.memory = resultImage.allocation.memory;
+	resultImage.imageView = createImageView(m_device, resultImage.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+	resultImage.format = format;
+	resultImage.width = width;
+	resultImage.height = height;
+	return resultImage;
+}
+
+LibGFX::DepthBuffer VkContext::createDepthBuffer(VkExtent2D extent, DepthPrecision precision, bool stencil /*= false*/, bool transient /*= false*/)
+{
+	return createDepthBuffer(extent, findSuitableDepthFormat(precision, stencil), transient);
+}
+
+LibGFX::DepthBuffer VkContext::createDepthBuffer(VkExtent2D extent, VkFormat format, bool transient /*= false*/)
 {
 	if (format == VK_FORMAT_UNDEFINED) {
 		throw std::runtime_error("Failed to find supported depth format");
 	}
 
 	// Create depth image
-	VkDeviceMemory depthImageMemory;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (transient) {
+		usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	}
+	MemoryAllocation depthImageAllocation;
 	VkImage depthImage = createVkImage(
-		m_physicalDevice,
-		m_device,
 		extent.width,
 		extent.height,
 		format,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		usage,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&depthImageMemory);
+		&depthImageAllocation);
+
+	// Attachment views of combined formats need both aspects
+	VkImageAspectFlags aspect = getDepthAspect(format);
 
 	// Create depth image view
 	VkImageView depthImageView = createImageView(
 		m_device, 
 		depthImage, 
 		format, 
-		VK_IMAGE_ASPECT_DEPTH_BIT);
+		aspect);
 
 	// Create depth buffer struct
 	DepthBuffer depthBuffer = {};
 	depthBuffer.format = format;
 	depthBuffer.image = depthImage;
-	depthBuffer.memory = depthImageMemory;
+	depthBuffer.memory = depthImageAllocation.memory;
+	depthBuffer.allocation = depthImageAllocation;
 	depthBuffer.imageView = depthImageView;
+	depthBuffer.transient = transient;
 	return depthBuffer;
 }
 
@@ -1003,7 +2061,7 @@ void VkContext::destroySwapChain(SwapchainInfo& swapchainInfo)
 	vkDestroySwapchainKHR(m_device, swapchainInfo.swapchain, nullptr);
 }
 
-VkImageView VkContext::createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType /*= VK_IMAGE_VIEW_TYPE_2D*/, uint32_t layers /*= 1*/)
+VkImageView VkContext::createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType /*= VK_IMAGE_VIEW_TYPE_2D*/, uint32_t layers /*= 1*/, uint32_t mipLevels /*= 1*/)
 {
 	VkImageViewCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1017,7 +2075,7 @@ VkImageView VkContext::createImageView(VkDevice device, VkImage image, VkFormat
 
 	createInfo.subresourceRange.aspectMask = aspectFlags;
 	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.levelCount = mipLevels;
 	createInfo.subresourceRange.baseArrayLayer = 0;
 	createInfo.subresourceRange.layerCount = layers;
 
@@ -1077,13 +2135,168 @@ VkSurfaceFormatKHR VkContext::chooseSwapSurfaceFormat(const std::vector<VkSurfac
 
 SwapchainInfo VkContext::createSwapChain(VkPresentModeKHR desiredPresentMode)
 {
+	if (isHeadless()) {
+		throw std::runtime_error("Failed to create swapchain: context is headless");
+	}
+
 	// Check if desired present mode is available
 	if (!this->isPresentModeAvailable(desiredPresentMode)) {
 		throw std::runtime_error("Desired present mode is not available");
 	}
 
-	// TODO: Create isPresentModeAvailable public helper method
+	return buildSwapChain(desiredPresentMode, 0, VK_NULL_HANDLE);
+}
+
+SwapchainInfo VkContext::createSwapChain(PresentPolicy policy)
+{
+	if (isHeadless()) {
+		throw std::runtime_error("Failed to create swapchain: context is headless");
+	}
+
+	std::vector<VkPresentModeKHR> preferredModes;
+	uint32_t extraImages = 1;
+	switch (policy) {
+	case PresentPolicy::LowestLatency:
+		preferredModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+		extraImages = 0;
+		break;
+	case PresentPolicy::LowLatencyNoTearing:
+		preferredModes = { VK_PRESENT_MODE_MAILBOX_KHR };
+		extraImages = 1;
+		break;
+	case PresentPolicy::MaxThroughput:
+		preferredModes = { VK_PRESENT_MODE_MAILBOX_KHR };
+		extraImages = 2;
+		break;
+	case PresentPolicy::Vsync:
+		extraImages = 1;
+		break;
+	}
+
+	// FIFO is guaranteed to be supported
+	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_physicalDevice);
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (auto preferredMode : preferredModes) {
+		if (std::find(swapChainSupport.presentModes.begin(), swapChainSupport.presentModes.end(), preferredMode) != swapChainSupport.presentModes.end()) {
+			presentMode = preferredMode;
+			break;
+		}
+	}
+
+	// Mailbox needs a spare image to replace, never go below two images
+	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + extraImages;
+	if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+		imageCount = std::max(imageCount, 3u);
+	}
+	imageCount = std::max(imageCount, 2u);
+	return buildSwapChain(presentMode, imageCount, VK_NULL_HANDLE);
+}
+
+bool VkContext::recreateSwapChain(SwapchainInfo& swapchainInfo)
+{
+	// Nothing to present into while minimized
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(m_targetWindow, &width, &height);
+	if (width == 0 || height == 0) {
+		return false;
+	}
+
+	// The old chain stays valid for images already acquired or queued for present
+	SwapchainInfo newSwapchainInfo = buildSwapChain(swapchainInfo.presentMode, swapchainInfo.imageCount, swapchainInfo.swapchain);
+
+	// One retired chain per batch
+	if (m_openRetirement.swapchain != VK_NULL_HANDLE) {
+		sealRetirement();
+	}
+	m_openRetirement.swapchain = swapchainInfo.swapchain;
+	m_openRetirement.imageViews.insert(m_openRetirement.imageViews.end(), swapchainInfo.imageViews.begin(), swapchainInfo.imageViews.end());
+	swapchainInfo = std::move(newSwapchainInfo);
+	return true;
+}
+
+void VkContext::retireFramebuffers(std::vector<VkFramebuffer>& framebuffers)
+{
+	m_openRetirement.framebuffers.insert(m_openRetirement.framebuffers.end(), framebuffers.begin(), framebuffers.end());
+	framebuffers.clear();
+}
+
+void VkContext::retireDepthBuffer(DepthBuffer& depthBuffer)
+{
+	m_openRetirement.depthBuffers.push_back(depthBuffer);
+	depthBuffer = {};
+}
+
+void VkContext::retireSemaphores(std::vector<VkSemaphore>& semaphores)
+{
+	m_openRetirement.semaphores.insert(m_openRetirement.semaphores.end(), semaphores.begin(), semaphores.end());
+	semaphores.clear();
+}
+
+uint64_t VkContext::retireImage(Image& image)
+{
+	m_openRetirement.images.push_back(image);
+	image = {};
+	return m_sealedRetirements;
+}
+
+void VkContext::collectRetiredResources()
+{
+	sealRetirement();
+
+	while (!m_retiredResources.empty() && vkGetFenceStatus(m_device, m_retiredResources.front().fence) == VK_SUCCESS) {
+		destroyRetiredResources(m_retiredResources.front());
+		m_retiredResources.pop_front();
+		m_collectedRetirements++;
+	}
+}
+
+void VkContext::sealRetirement()
+{
+	if (m_openRetirement.isEmpty()) {
+		return;
+	}
+
+	// The fence of an empty submission signals once everything submitted so far has completed
+	m_openRetirement.fence = createFence();
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	if (vkQueueSubmit(m_graphicsQueue, 0, nullptr, m_openRetirement.fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit retirement fence");
+	}
+	m_retiredResources.push_back(std::move(m_openRetirement));
+	m_openRetirement = RetiredResources();
+	m_sealedRetirements++;
+}
+
+void VkContext::destroyRetiredResources(RetiredResources& resources)
+{
+	for (auto& framebuffer : resources.framebuffers) {
+		destroyFramebuffer(framebuffer);
+	}
+	for (auto& depthBuffer : resources.depthBuffers) {
+		destroyDepthBuffer(depthBuffer);
+	}
+	for (auto& image : resources.images) {
+		destroyImage(image);
+	}
+	for (auto imageView : resources.imageViews) {
+		vkDestroyImageView(m_device, imageView, nullptr);
+	}
+	for (auto semaphore : resources.semaphores) {
+		vkDestroySemaphore(m_device, semaphore, nullptr);
+	}
+	if (resources.swapchain != VK_NULL_HANDLE) {
+		vkDestroySwapchainKHR(m_device, resources.swapchain, nullptr);
+	}
+	if (resources.fence != VK_NULL_HANDLE) {
+		destroyFence(resources.fence);
+	}
+	resources = RetiredResources();
+}
+
+SwapchainInfo VkContext::buildSwapChain(VkPresentModeKHR presentMode, uint32_t desiredImageCount, VkSwapchainKHR oldSwapchain)
+{
 	SwapchainInfo swapchainInfo;
+	swapchainInfo.presentMode = presentMode;
 
 	// Get swap chain support details
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_physicalDevice);
@@ -1091,9 +2304,10 @@ SwapchainInfo VkContext::createSwapChain(VkPresentModeKHR desiredPresentMode)
 	// Choose swap surface format, present mode and extent
 	swapchainInfo.surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	swapchainInfo.extent = chooseSwapchainExtent(swapChainSupport.capabilities);
-	swapchainInfo.imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	swapchainInfo.imageCount = desiredImageCount > 0 ? desiredImageCount : swapChainSupport.capabilities.minImageCount + 1;
 
 	// Set image count within allowed limits
+	swapchainInfo.imageCount = std::max(swapchainInfo.imageCount, swapChainSupport.capabilities.minImageCount);
 	if(swapChainSupport.capabilities.maxImageCount > 0 && swapChainSupport.capabilities.maxImageCount < swapchainInfo.imageCount) {
 		swapchainInfo.imageCount = swapChainSupport.capabilities.maxImageCount;
 	}
@@ -1104,21 +2318,23 @@ SwapchainInfo VkContext::createSwapChain(VkPresentModeKHR desiredPresentMode)
 	createInfo.surface = m_surface;
 	createInfo.imageFormat = swapchainInfo.surfaceFormat.format;
 	createInfo.imageColorSpace = swapchainInfo.surfaceFormat.colorSpace;
-	createInfo.presentMode = desiredPresentMode;
+	createInfo.presentMode = presentMode;
 	createInfo.imageExtent = swapchainInfo.extent;
 	createInfo.minImageCount = swapchainInfo.imageCount;
 	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// Transfer source for screenshots where the surface allows it
+	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	swapchainInfo.imageUsage = createInfo.imageUsage;
 	createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.clipped = VK_TRUE;
 
-	QueueFamilyIndices indices = getQueueFamilyIndices(m_physicalDevice);
+	QueueFamilyIndices indices = m_queueFamilyIndices;
+	uint32_t queueFamilyIndices[] = {
+		static_cast<uint32_t>(indices.graphicsFamily),
+		static_cast<uint32_t>(indices.presentFamily)
+	};
 	if (!indices.gpShared()) {
-		uint32_t queueFamilyIndices[] = {
-			static_cast<uint32_t>(indices.graphicsFamily),
-			static_cast<uint32_t>(indices.presentFamily)
-		};
 		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
 		createInfo.queueFamilyIndexCount = 2;
 		createInfo.pQueueFamilyIndices = queueFamilyIndices;
@@ -1128,7 +2344,7 @@ SwapchainInfo VkContext::createSwapChain(VkPresentModeKHR desiredPresentMode)
 		createInfo.queueFamilyIndexCount = 0;
 		createInfo.pQueueFamilyIndices = nullptr;
 	}
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &swapchainInfo.swapchain) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create swap chain");
@@ -1153,7 +2369,24 @@ void VkContext::dispose()
 {
 	if (m_device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(m_device);
-		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+		m_retiredResources.push_back(std::move(m_openRetirement));
+		m_openRetirement = RetiredResources();
+		for (auto& resources : m_retiredResources) {
+			destroyRetiredResources(resources);
+		}
+		m_retiredResources.clear();
+		m_sealedRetirements++;
+		m_collectedRetirements = m_sealedRetirements;
+		destroyCommandPool(m_transferCommandPool);
+		if (m_pipelineCache != VK_NULL_HANDLE) {
+			vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+			m_pipelineCache = VK_NULL_HANDLE;
+		}
+		m_allocator.dispose();
+		if (m_surface != VK_NULL_HANDLE) {
+			vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+			m_surface = VK_NULL_HANDLE;
+		}
 		vkDestroyDevice(m_device, nullptr);
 		vkDestroyInstance(m_instance, nullptr);
 	}
@@ -1188,7 +2421,7 @@ bool VkContext::checkDeviceExtensionSupport(VkPhysicalDevice device, const std::
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 	if (extensionCount == 0) {
-		return false;
+		return deviceExtensions.empty();
 	}
 
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
@@ -1221,21 +2454,52 @@ LibGFX::QueueFamilyIndices VkContext::getQueueFamilyIndices(VkPhysicalDevice dev
 
 	for (uint32_t i = 0; i < queueFamilies.size(); i++) {
 		auto& queueFamily = queueFamilies[i];
+		if (queueFamily.queueCount == 0) {
+			continue;
+		}
 
-		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+		if (indices.graphicsFamily < 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 			indices.graphicsFamily = static_cast<int>(i);
 		}
 
+		// Prefer presenting from the graphics family
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
-		if (presentSupport) {
+		if (m_surface != VK_NULL_HANDLE) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+		}
+		if (presentSupport && (indices.presentFamily < 0 || static_cast<int>(i) == indices.graphicsFamily)) {
 			indices.presentFamily = static_cast<int>(i);
 		}
+	}
 
-		if (indices.isValid())
-		{
-			break;
+	// Transfer: prefer a DMA only family, then any non graphics family that can copy
+	for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (queueFamilies[i].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+		bool canTransfer = (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) != 0;
+		bool transferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+		if (canTransfer && (indices.transferFamily < 0 || transferOnly)) {
+			indices.transferFamily = static_cast<int>(i);
 		}
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && indices.computeFamily < 0) {
+			indices.computeFamily = static_cast<int>(i);
+		}
+	}
+
+	// Collapse onto the graphics family when there are no separate families (e.g. lavapipe)
+	if (indices.transferFamily < 0) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+	if (indices.computeFamily < 0) {
+		indices.computeFamily = indices.graphicsFamily;
+	}
+
+	// Transfer and compute on the same non graphics family get their own queues when the family has enough,
+	// roles collapsed onto the graphics family share its queue on purpose so submission order keeps them in sync
+	if (indices.hasDedicatedTransfer() && indices.transferFamily == indices.computeFamily && queueFamilies[indices.computeFamily].queueCount > 1) {
+		indices.computeQueueIndex = 1;
 	}
 	return indices;
 }
@@ -1252,6 +2516,11 @@ bool VkContext::isDeviceSuitable(VkPhysicalDevice device, const std::vector<cons
 	// Check for required DEVICE EXTENSIONS not instance extensions 
 	bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtensions);
 
+	// Headless contexts only need a graphics queue
+	if (isHeadless()) {
+		return indices.graphicsFamily >= 0 && extensionsSupported && deviceFeatures.samplerAnisotropy;
+	}
+
 	// Check for swap chain support
 	SwapChainSupportDetails swapChainDetails = querySwapChainSupport(device);
 	bool swapChainAdequate = swapChainDetails.isValid();
@@ -1289,7 +2558,10 @@ VkApplicationInfo VkContext::defaultAppInfo()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "LibGFX";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_1;
+	// Vulkan 1.3 when the loader supports it, the device may still be older
+	uint32_t instanceVersion = VK_API_VERSION_1_1;
+	vkEnumerateInstanceVersion(&instanceVersion);
+	appInfo.apiVersion = instanceVersion >= VK_API_VERSION_1_3 ? VK_API_VERSION_1_3 : VK_API_VERSION_1_1;
 	return appInfo;
 }
 
@@ -1350,20 +2622,24 @@ void VkContext::initialize(VkApplicationInfo appInfo, bool enableValidationLayer
 	std::cout << "Initializing Vulkan Renderer..." << std::endl;
 
 	// Check for validation layers
-	std::cout << "Creating Validation Layers..." << std::endl;
 	std::vector<const char*> layers;
-	layers.push_back("VK_LAYER_KHRONOS_validation");
-	if (!this->hasRequiredLayers(layers)) {
-		throw std::runtime_error("Required validation layers not available");
+	if (enableValidationLayers) {
+		std::cout << "Creating Validation Layers..." << std::endl;
+		layers.push_back("VK_LAYER_KHRONOS_validation");
+		if (!this->hasRequiredLayers(layers)) {
+			throw std::runtime_error("Required validation layers not available");
+		}
 	}
 
-	// Get required instance extensions from GLFW
+	// Get required instance extensions from GLFW, a headless context needs none
 	std::vector<const char*> extensions;
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	for (size_t i = 0; i < glfwExtensionCount; i++) {
-		extensions.push_back(glfwExtensions[i]);
+	if (!isHeadless()) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		for (size_t i = 0; i < glfwExtensionCount; i++) {
+			extensions.push_back(glfwExtensions[i]);
+		}
 	}
 
 	// Check if all required extensions are available
@@ -1375,6 +2651,7 @@ void VkContext::initialize(VkApplicationInfo appInfo, bool enableValidationLayer
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
+	m_apiVersion = appInfo.apiVersion != 0 ? appInfo.apiVersion : VK_API_VERSION_1_0;
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 	if (enableValidationLayers) {
@@ -1392,40 +2669,181 @@ void VkContext::initialize(VkApplicationInfo appInfo, bool enableValidationLayer
 	std::cout << "Vulkan instance created successfully!" << std::endl;
 
 	// Create Surface
-	std::cout << "Creating Vulkan Surface..." << std::endl;
-	if (glfwCreateWindowSurface(m_instance, m_targetWindow, nullptr, &m_surface) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Vulkan surface");
+	std::vector<const char*> deviceExtensions;
+	if (!isHeadless()) {
+		std::cout << "Creating Vulkan Surface..." << std::endl;
+		if (glfwCreateWindowSurface(m_instance, m_targetWindow, nullptr, &m_surface) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Vulkan surface");
+		}
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+	else {
+		std::cout << "Running headless, no surface and swapchain" << std::endl;
 	}
-
-	// Select the required device extensions
-	std::cout << "Selecting Physical Device..." << std::endl;
-	const std::vector<const char*> deviceExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
 
 	// Select the physical device
+	std::cout << "Selecting Physical Device..." << std::endl;
 	m_physicalDevice = selectPhysicalDevice(deviceExtensions);
 	if (m_physicalDevice == VK_NULL_HANDLE) {
 		throw std::runtime_error("Failed to find a suitable GPU");
 	}
 
 	// Print selected device name
-	VkPhysicalDeviceProperties deviceProperties;
-	vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
-	std::cout << "Selected GPU: " << deviceProperties.deviceName << std::endl;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &m_physicalDeviceProperties);
+	std::cout << "Selected GPU: " << m_physicalDeviceProperties.deviceName << std::endl;
+
+	// Optional extensions, feature structs are chained into the device create info.
+	// Querying them needs vkGetPhysicalDeviceFeatures2, core in 1.1; a 1.0 instance keeps them off.
+	void* featureChain = nullptr;
+	bool features2Core = std::min(m_apiVersion, m_physicalDeviceProperties.apiVersion) >= VK_API_VERSION_1_1;
+	m_pipelineCreationFeedback = checkDeviceExtensionSupport(m_physicalDevice, { VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME });
+	if (m_pipelineCreationFeedback) {
+		deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+	}
+
+	// Present id and present wait for frame pacing telemetry
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	if (!isHeadless() && features2Core && checkDeviceExtensionSupport(m_physicalDevice, { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME })) {
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+		m_presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		if (m_presentWait) {
+			deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.pNext = featureChain;
+			featureChain = &presentIdFeatures;
+		}
+	}
+
+	// Dynamic rendering, core in Vulkan 1.3 and an extension before
+	VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+	bool dynamicRenderingCore = std::min(m_apiVersion, m_physicalDeviceProperties.apiVersion) >= VK_API_VERSION_1_3;
+	std::vector<const char*> dynamicRenderingExtensions = { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME };
+	if (dynamicRenderingCore || (features2Core && checkDeviceExtensionSupport(m_physicalDevice, dynamicRenderingExtensions))) {
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &dynamicRenderingFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+		m_dynamicRendering = dynamicRenderingFeatures.dynamicRendering;
+		if (m_dynamicRendering) {
+			if (!dynamicRenderingCore) {
+				deviceExtensions.insert(deviceExtensions.end(), dynamicRenderingExtensions.begin(), dynamicRenderingExtensions.end());
+			}
+			dynamicRenderingFeatures.pNext = featureChain;
+			featureChain = &dynamicRenderingFeatures;
+		}
+	}
+
+	// Descriptor buffers, needs buffer device addresses (core in 1.2) and synchronization2 before 1.3
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+	descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+	VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {};
+	bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+	bool bufferDeviceAddress = false;
+	std::vector<const char*> descriptorBufferExtensions = { VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME };
+	if (!dynamicRenderingCore) {	// synchronization2 is core in 1.3 as well
+		descriptorBufferExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+	}
+	if (std::min(m_apiVersion, m_physicalDeviceProperties.apiVersion) >= VK_API_VERSION_1_2 && checkDeviceExtensionSupport(m_physicalDevice, descriptorBufferExtensions)) {
+		descriptorBufferFeatures.pNext = &bufferDeviceAddressFeatures;
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &descriptorBufferFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+		m_descriptorBuffer = descriptorBufferFeatures.descriptorBuffer && bufferDeviceAddressFeatures.bufferDeviceAddress;
+		if (m_descriptorBuffer) {
+			deviceExtensions.insert(deviceExtensions.end(), descriptorBufferExtensions.begin(), descriptorBufferExtensions.end());
+
+			// Only the features the backend uses, capture replay and push descriptors stay off
+			descriptorBufferFeatures = {};
+			descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+			descriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+			descriptorBufferFeatures.pNext = &bufferDeviceAddressFeatures;
+			bufferDeviceAddressFeatures = {};
+			bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+			bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+			bufferDeviceAddressFeatures.pNext = featureChain;
+			bufferDeviceAddress = true;
+			featureChain = &descriptorBufferFeatures;
+
+			m_descriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+			VkPhysicalDeviceProperties2 properties2 = {};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties2.pNext = &m_descriptorBufferProperties;
+			vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties2);
+		}
+	}
+
+	// Descriptor indexing for bindless tables, core in 1.2 and an extension before
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+	descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	bool descriptorIndexingCore = std::min(m_apiVersion, m_physicalDeviceProperties.apiVersion) >= VK_API_VERSION_1_2;
+	std::vector<const char*> descriptorIndexingExtensions = { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_MAINTENANCE3_EXTENSION_NAME };
+	if (m_bindlessRequested && (descriptorIndexingCore || (features2Core && checkDeviceExtensionSupport(m_physicalDevice, descriptorIndexingExtensions)))) {
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &descriptorIndexingFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+		m_bindless = descriptorIndexingFeatures.runtimeDescriptorArray
+			&& descriptorIndexingFeatures.descriptorBindingPartiallyBound
+			&& descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending
+			&& descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+			&& descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+			&& descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing
+			&& descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+		if (m_bindless) {
+			if (!descriptorIndexingCore) {
+				deviceExtensions.insert(deviceExtensions.end(), descriptorIndexingExtensions.begin(), descriptorIndexingExtensions.end());
+			}
+
+			// Only what BindlessTable relies on
+			descriptorIndexingFeatures = {};
+			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+			descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+			descriptorIndexingFeatures.pNext = featureChain;
+			featureChain = &descriptorIndexingFeatures;
+
+			m_descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+			VkPhysicalDeviceProperties2 properties2 = {};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties2.pNext = &m_descriptorIndexingProperties;
+			vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties2);
+		}
+	}
 
 	// Create Logical Device
 	QueueFamilyIndices indices = getQueueFamilyIndices(m_physicalDevice);
+	m_queueFamilyIndices = indices;
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+	std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.transferFamily, indices.computeFamily };
+	if (!isHeadless()) {
+		uniqueQueueFamilies.insert(indices.presentFamily);
+	}
 
+	float queuePriorities[] = { 1.0f, 1.0f };
 	for (int queueFamilyIndex : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = static_cast<uint32_t>(queueFamilyIndex);
-		queueCreateInfo.queueCount = 1;
-		float queuePriority = 1.0f;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = queueFamilyIndex == indices.computeFamily ? indices.computeQueueIndex + 1 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
@@ -1439,6 +2857,7 @@ void VkContext::initialize(VkApplicationInfo appInfo, bool enableValidationLayer
 	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
 	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+	deviceCreateInfo.pNext = featureChain;
 
 	if (vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_device) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create logical device");
@@ -1448,5 +2867,47 @@ void VkContext::initialize(VkApplicationInfo appInfo, bool enableValidationLayer
 
 	// Get queues
 	vkGetDeviceQueue(m_device, indices.graphicsFamily, 0, &m_graphicsQueue);
-	vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+	if (!isHeadless()) {
+		vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+	}
+	vkGetDeviceQueue(m_device, indices.transferFamily, indices.transferQueueIndex, &m_transferQueue);
+	vkGetDeviceQueue(m_device, indices.computeFamily, indices.computeQueueIndex, &m_computeQueue);
+	if (indices.hasDedicatedTransfer()) {
+		std::cout << "Using dedicated transfer queue family " << indices.transferFamily << std::endl;
+	}
+	if (indices.hasDedicatedCompute()) {
+		std::cout << "Using dedicated compute queue family " << indices.computeFamily << std::endl;
+	}
+
+	// Extension entry points
+	if (m_presentWait) {
+		m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+		m_presentWait = m_vkWaitForPresentKHR != nullptr;
+	}
+	if (m_dynamicRendering) {
+		m_vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(m_device, dynamicRenderingCore ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+		m_vkCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(m_device, dynamicRenderingCore ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+		m_dynamicRendering = m_vkCmdBeginRendering != nullptr && m_vkCmdEndRendering != nullptr;
+	}
+	if (m_descriptorBuffer) {
+		m_vkGetBufferDeviceAddress = reinterpret_cast<PFN_vkGetBufferDeviceAddress>(vkGetDeviceProcAddr(m_device, "vkGetBufferDeviceAddress"));
+		m_vkGetDescriptorSetLayoutSizeEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutSizeEXT"));
+		m_vkGetDescriptorSetLayoutBindingOffsetEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+		m_vkGetDescriptorEXT = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorEXT"));
+		m_vkCmdBindDescriptorBuffersEXT = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(m_device, "vkCmdBindDescriptorBuffersEXT"));
+		m_vkCmdSetDescriptorBufferOffsetsEXT = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(m_device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+		m_descriptorBuffer = m_vkGetBufferDeviceAddress != nullptr && m_vkGetDescriptorSetLayoutSizeEXT != nullptr && m_vkGetDescriptorSetLayoutBindingOffsetEXT != nullptr
+			&& m_vkGetDescriptorEXT != nullptr && m_vkCmdBindDescriptorBuffersEXT != nullptr && m_vkCmdSetDescriptorBufferOffsetsEXT != nullptr;
+	}
+
+	// Create the device memory allocator, device addresses stay enabled even if an entry point is missing
+	m_allocator.initialize(m_physicalDevice, m_device, bufferDeviceAddress);
+
+	// Internal command pool for uploads on the transfer queue
+	m_transferCommandPool = createCommandPool(static_cast<uint32_t>(indices.transferFamily));
+
+	// Empty pipeline cache, loadPipelineCache replaces it with the data from disk
+	if (createPipelineCache(nullptr, 0, &m_pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
 }
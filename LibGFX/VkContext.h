@@ -2,6 +2,10 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <functional>
+#include <string>
+#include <deque>
+#include <mutex>
 #include "QueueFamilyIndices.h"
 #include "SwapchainSupportDetails.h"
 #include "SwapchainInfo.h"
@@ -10,30 +14,69 @@
 #include "Pipeline.h"
 #include "Buffer.h"
 #include "Imaging.h"
+#include "MemoryAllocator.h"
+#include "PipelineCacheStats.h"
+#include "PresentPolicy.h"
+#include "TraceRecorder.h"
+#include "RenderingInfo.h"
+#include "DescriptorBackend.h"
 
 namespace LibGFX {
 	class VkContext {
 	public:
-		VkContext(GLFWwindow* targetWindow);
+		// Without a target window the context runs headless: no surface, swapchain or present queue
+		VkContext(GLFWwindow* targetWindow = nullptr);
 		~VkContext();
 
 		static VkApplicationInfo defaultAppInfo();
 
 		void initialize(VkApplicationInfo appInfo, bool enableValidationLayers = true);
+		// Opt-in descriptor indexing for BindlessTable, must be called before initialize
+		void requestBindless(bool enable = true) { m_bindlessRequested = enable; }
 		void dispose();
 
 		// Swapchain functions
 		SwapchainInfo createSwapChain(VkPresentModeKHR desiredPresentMode);
+		SwapchainInfo createSwapChain(PresentPolicy policy);
 		void destroySwapChain(SwapchainInfo& swapchainInfo);
+		// Builds the new chain from the old one without waiting for the device, the old chain is retired.
+		// Returns false and keeps the old chain while the window has a zero sized framebuffer (minimized).
+		bool recreateSwapChain(SwapchainInfo& swapchainInfo);
+
+		// Deferred destruction: retired resources are destroyed once all work submitted before their retirement is done
+		void retireFramebuffers(std::vector<VkFramebuffer>& framebuffers);
+		void retireDepthBuffer(DepthBuffer& depthBuffer);
+		void retireSemaphores(std::vector<VkSemaphore>& semaphores);
+		// Returns the retirement the image belongs to, see isRetirementCollected
+		uint64_t retireImage(Image& image);
+		void collectRetiredResources();
+		bool isRetirementCollected(uint64_t retirement) const { return retirement < m_collectedRetirements; }
 		
 		// Public functions
 		VkFormat selectSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
-		DepthBuffer createDepthBuffer(VkExtent2D extent, VkFormat format);
+		bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
+		// First candidate that can be sampled with optimal tiling, e.g. { BC7, ASTC_4x4, ETC2_RGBA8, R8G8B8A8 }
+		VkFormat selectTextureFormat(const std::vector<VkFormat>& candidates);
+		// Transient depth buffers are never stored (STORE_OP_DONT_CARE) and prefer lazily allocated memory
+		DepthBuffer createDepthBuffer(VkExtent2D extent, VkFormat format, bool transient = false);
+		DepthBuffer createDepthBuffer(VkExtent2D extent, DepthPrecision precision, bool stencil = false, bool transient = false);
+		// Attachments that are never stored can add VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT to get lazily allocated memory
+		Image createRenderTarget(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 		void destroyDepthBuffer(DepthBuffer& depthBuffer);
 		void destroyDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
 		VkShaderModule createShaderModule(const std::vector<char>& code);
 		void destroyShaderModule(VkShaderModule shaderModule);
 
+		// Pipeline functions, creation goes through the context pipeline cache
+		VkPipeline createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo);
+		VkPipeline createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, const RenderingFormats& renderingFormats);
+		VkPipeline createComputePipeline(const VkComputePipelineCreateInfo& createInfo);
+		void destroyPipeline(VkPipeline& pipeline);
+		bool loadPipelineCache(const std::string& filename);
+		void savePipelineCache(const std::string& filename);
+		VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+		const PipelineCacheStats& getPipelineCacheStats() const { return m_pipelineCacheStats; }
+
 		// Framebuffer functions
 		VkFramebuffer createFramebuffer(RenderPass& renderPass, VkImageView imageView, DepthBuffer depthBuffer, VkExtent2D extent);
 		VkFramebuffer createFramebuffer(RenderPass& renderPass, VkImageView imageView, VkExtent2D extent);
@@ -53,14 +96,16 @@ namespace LibGFX {
 
 		// Sampler functions
 		VkSampler createSampler(const VkSamplerCreateInfo& createInfo);
-		VkSampler createTextureSampler(bool enableAnisotropy = true, float maxAnisotropy = 16.0f);
-		VkSampler createCubeMapSampler(bool enableAnisotropy = true, float maxAnisotropy = 16.0f);
+		VkSampler createTextureSampler(bool enableAnisotropy = true, float maxAnisotropy = 16.0f, uint32_t mipLevels = 1);
+		VkSampler createCubeMapSampler(bool enableAnisotropy = true, float maxAnisotropy = 16.0f, uint32_t mipLevels = 1);
 		void destroySampler(VkSampler& sampler);
 
 		// Descriptor set functions
 		void destroyDescriptorSetPool(VkDescriptorPool& descriptorPool);
 		VkDescriptorSet allocateDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout);
 		void freeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSet& descriptorSet);
+		void updateDescriptorSetWithTemplate(VkDescriptorSet descriptorSet, VkDescriptorUpdateTemplate updateTemplate, const void* data);
+		void destroyDescriptorUpdateTemplate(VkDescriptorUpdateTemplate& updateTemplate);
 
 		// Semaphore & Fence functions
 		VkSemaphore createSemaphore();
@@ -76,62 +121,189 @@ namespace LibGFX {
 		void resetFence(VkFence fence);
 
 		// Buffer
-		Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		// preferredProperties are used when a matching memory type exists, e.g. HOST_CACHED for readback
+		Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties = 0);
 		void updateBuffer(const Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		void flushBuffer(const Buffer& buffer, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		void invalidateBuffer(const Buffer& buffer, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void copyBuffer(VkCommandPool commandPool, const Buffer& srcBuffer, const Buffer& dstBuffer, VkDeviceSize size);
 		void copyBufferToImage(VkCommandPool commandPool, const Buffer& srcBuffer, VkImage dstImage, uint32_t width, uint32_t height);
 		void copyBufferToImageArray(VkCommandPool commandPool, const Buffer& srcBuffer, VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount, VkDeviceSize layerSize);
+		void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount = 1, VkDeviceSize layerSize = 0);
+		void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, const std::vector<VkBufferImageCopy>& regions);
 		void resizeBuffer(VkCommandPool commandPool, Buffer& buffer, VkDeviceSize newSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 		void recreateBuffer(Buffer& buffer, VkDeviceSize newSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 		void destroyBuffer(Buffer& buffer);
 
 		// Image
-		Image createImage(const ImageData& imageData, VkCommandPool commandPool, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		Cubemap createCubemap(const CubemapData& cubemapData, VkCommandPool commandPool, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		// generateMipmaps builds the full chain from level 0 on the GPU, otherwise the levels in the data are uploaded as they are
+		Image createImage(const ImageData& imageData, VkCommandPool commandPool, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, bool generateMipmaps = false);
+		Cubemap createCubemap(const CubemapData& cubemapData, VkCommandPool commandPool, VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, bool generateMipmaps = false);
 		void destroyImage(Image& image);
 		void destroyCubemap(Cubemap& cubemap);
+		// aspectMask 0 picks color, or depth for depth layouts. Pass getDepthAspect(format) for formats with stencil.
+		// Throws for layouts without a known access scope.
+		void recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseArrayLayer = 0, VkImageAspectFlags aspectMask = 0);
+
+		// Expects all levels in TRANSFER_DST_OPTIMAL with level 0 filled, leaves all levels in SHADER_READ_ONLY_OPTIMAL.
+		// Must be recorded on the graphics queue.
+		void recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount = 1);
+		bool supportsLinearBlit(VkFormat format);
+
+		// Queue family ownership transfer from the transfer to the graphics queue.
+		// Without a dedicated transfer family the release is a no-op and the acquire a plain barrier.
+		void recordImageRelease(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseArrayLayer = 0);
+		void recordImageAcquire(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseArrayLayer = 0);
+		void recordBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		void recordBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		// The way back before the transfer queue overwrites a range graphics may still access. The graphics submission holding
+		// the release signals a semaphore the transfer submission waits on. Without a dedicated transfer family the release
+		// is a no-op and the acquire orders the copy after all earlier work on the shared queue.
+		void recordBufferReleaseToTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		void recordBufferAcquireForTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess = VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		// Queue family ownership transfer of compute shader writes from the compute to the graphics queue, the submissions
+		// are ordered by a semaphore. Without a dedicated compute family the release is a no-op and the acquire a plain barrier.
+		void recordComputeBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		void recordComputeBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE, VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkAccessFlags dstAccess = VK_ACCESS_MEMORY_READ_BIT);
+		// The way back for buffers compute rewrites while graphics may still read them (write-after-read).
+		// The graphics submission holding the release must complete before the compute submission, e.g. through the frame fence.
+		void recordGraphicsBufferRelease(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE, VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		void recordGraphicsBufferAcquire(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE, VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		// Barrier on a single queue, e.g. between two dispatches or from a dispatch to an indirect draw
+		void recordBufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
 
 		// Present & Graphics queue access
 		VkResult acquireNextImage(const SwapchainInfo& swapchainInfo, VkSemaphore signalSemaphore, VkFence fence, uint32_t& imageIndex, uint64_t timeout = std::numeric_limits<uint64_t>::max());
 		void beginCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags = 0);
 		void beginRenderPass(VkCommandBuffer commandBuffer, const RenderPass& renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void bindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, const Pipeline& pipeline);
+		void dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+		// The buffer holds a VkDispatchIndirectCommand at offset and needs INDIRECT_BUFFER usage
+		void dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0);
 		void endRenderPass(VkCommandBuffer commandBuffer);
+
+		// Dynamic rendering (Vulkan 1.3 or VK_KHR_dynamic_rendering), the render pass path stays available as fallback
+		bool supportsDynamicRendering() const { return m_dynamicRendering; }
+		void beginRendering(VkCommandBuffer commandBuffer, VkExtent2D extent, const std::vector<RenderingAttachment>& colorAttachments, const RenderingAttachment* depthAttachment = nullptr, VkRenderingFlags flags = 0);
+		void endRendering(VkCommandBuffer commandBuffer);
 		void endCommandBuffer(VkCommandBuffer commandBuffer);
 
 		void submitCommandBuffer(const VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE);
+		void submitCommandBuffer(VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE);
 		void submitCommandBuffers(const std::vector<VkSubmitInfo>& submitInfos, VkFence fence = VK_NULL_HANDLE);
 		void queuePresent(VkQueue presentQueue, const VkPresentInfoKHR& presentInfo);
 		void queuePresent(const VkPresentInfoKHR& presentInfo);
+		// Returns SUBOPTIMAL and OUT_OF_DATE to the caller instead of throwing
+		VkResult tryQueuePresent(const VkPresentInfoKHR& presentInfo);
+		// VK_KHR_present_wait, only valid if supportsPresentWait() is true
+		VkResult waitForPresent(VkSwapchainKHR swapchain, uint64_t presentId, uint64_t timeout);
+		bool supportsPresentWait() const { return m_presentWait; }
 		void waitIdle();
 
+		// Descriptor buffers (VK_EXT_descriptor_buffer), enabled at init together with buffer device addresses when available
+		bool supportsDescriptorBuffer() const { return m_descriptorBuffer; }
+		DescriptorBackend getPreferredDescriptorBackend() const { return m_descriptorBuffer ? DescriptorBackend::Buffer : DescriptorBackend::Pool; }
+		const VkPhysicalDeviceDescriptorBufferPropertiesEXT& getDescriptorBufferProperties() const { return m_descriptorBufferProperties; }
+		VkDeviceAddress getBufferDeviceAddress(const Buffer& buffer) const;
+
+		// Descriptor indexing (Vulkan 1.2 or VK_EXT_descriptor_indexing), only enabled after requestBindless
+		bool supportsBindless() const { return m_bindless; }
+		const VkPhysicalDeviceDescriptorIndexingProperties& getDescriptorIndexingProperties() const { return m_descriptorIndexingProperties; }
+		VkDeviceSize getDescriptorSetLayoutSize(VkDescriptorSetLayout layout) const;
+		VkDeviceSize getDescriptorSetLayoutBindingOffset(VkDescriptorSetLayout layout, uint32_t binding) const;
+		void getDescriptor(const VkDescriptorGetInfoEXT& getInfo, size_t descriptorSize, void* descriptor) const;
+		void bindDescriptorBuffers(VkCommandBuffer commandBuffer, uint32_t bufferCount, const VkDescriptorBufferBindingInfoEXT* bindingInfos);
+		void setDescriptorBufferOffsets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet, uint32_t setCount, const uint32_t* bufferIndices, const VkDeviceSize* offsets);
+
 		// Getters
 		VkInstance getInstance() const { return m_instance; }
 		VkSurfaceKHR getSurface() const { return m_surface; }
+		bool isHeadless() const { return m_targetWindow == nullptr; }
 		VkPhysicalDevice getPhysicalDevice() const { return m_physicalDevice; }
+		const VkPhysicalDeviceProperties& getPhysicalDeviceProperties() const { return m_physicalDeviceProperties; }
 		VkDevice getDevice() const { return m_device; }
 		VkQueue getGraphicsQueue() const { return m_graphicsQueue; }
 		VkQueue getPresentQueue() const { return m_presentQueue; }
+		VkQueue getTransferQueue() const { return m_transferQueue; }
+		VkQueue getComputeQueue() const { return m_computeQueue; }
+		QueueFamilyIndices getQueueFamilyIndices() const { return m_queueFamilyIndices; }
+		MemoryAllocator& getAllocator() { return m_allocator; }
+
+		// Opt-in CPU tracing of allocations, submits and waits (nullptr disables it)
+		void setTraceRecorder(TraceRecorder* traceRecorder) { m_traceRecorder = traceRecorder; }
+		TraceRecorder* getTraceRecorder() const { return m_traceRecorder; }
+		MemoryStats getMemoryStats() const { return m_allocator.getStats(); }
 
 		// Public Helpers
 		bool isPresentModeAvailable(VkPresentModeKHR presentMode);
-		static VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layers = 1);
-		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layers = 1);
+		static VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layers = 1, uint32_t mipLevels = 1);
+		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layers = 1, uint32_t mipLevels = 1);
 		static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-		static VkImage createVkImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers = 1, VkImageCreateFlags flags = 0);
-		VkImage createVkImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers = 1, VkImageCreateFlags flags = 0);
+		static VkImage createVkImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory* imageMemory, uint32_t layers = 1, VkImageCreateFlags flags = 0, uint32_t mipLevels = 1);
+		VkImage createVkImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryAllocation* imageAllocation, uint32_t layers = 1, VkImageCreateFlags flags = 0, uint32_t mipLevels = 1);
+		// Expects the staging layout of packStagingLevels, every level aligned to getCopyAlignment
+		static std::vector<VkBufferImageCopy> getMipCopyRegions(VkDeviceSize srcOffset, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, uint32_t layerCount = 1, VkDeviceSize layerStride = 0, uint32_t baseArrayLayer = 0);
 		static VkViewport createViewport(float x, float y, VkExtent2D extent, float minDepth = 0.0f, float maxDepth = 1.0f);
 		static VkRect2D createScissorRect(int32_t offsetX, int32_t offsetY, VkExtent2D extent);
 		VkFormat findSuitableDepthFormat();
+		VkFormat findSuitableDepthFormat(DepthPrecision precision, bool stencil = false);
 		QueueFamilyIndices getQueueFamilyIndices(VkPhysicalDevice device);
 	private:
 		VkInstance m_instance;
-		VkSurfaceKHR m_surface;
+		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 		VkPhysicalDevice m_physicalDevice;
+		VkPhysicalDeviceProperties m_physicalDeviceProperties;
 		VkDevice m_device;
 		VkQueue m_graphicsQueue;
-		VkQueue m_presentQueue;
+		VkQueue m_presentQueue = VK_NULL_HANDLE;
+		VkQueue m_transferQueue = VK_NULL_HANDLE;
+		VkQueue m_computeQueue = VK_NULL_HANDLE;
+		QueueFamilyIndices m_queueFamilyIndices;
+		VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		PipelineCacheStats m_pipelineCacheStats;
+		bool m_pipelineCreationFeedback = false;
+		bool m_presentWait = false;
+		bool m_dynamicRendering = false;
+		bool m_descriptorBuffer = false;
+		bool m_bindlessRequested = false;
+		bool m_bindless = false;
+		VkPhysicalDeviceDescriptorIndexingProperties m_descriptorIndexingProperties = {};
+		uint32_t m_apiVersion = VK_API_VERSION_1_0;
+		VkPhysicalDeviceDescriptorBufferPropertiesEXT m_descriptorBufferProperties = {};
+		PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr;
+		PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
+		PFN_vkWaitForPresentKHR m_vkWaitForPresentKHR = nullptr;
+		PFN_vkGetBufferDeviceAddress m_vkGetBufferDeviceAddress = nullptr;
+		PFN_vkGetDescriptorSetLayoutSizeEXT m_vkGetDescriptorSetLayoutSizeEXT = nullptr;
+		PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_vkGetDescriptorSetLayoutBindingOffsetEXT = nullptr;
+		PFN_vkGetDescriptorEXT m_vkGetDescriptorEXT = nullptr;
+		PFN_vkCmdBindDescriptorBuffersEXT m_vkCmdBindDescriptorBuffersEXT = nullptr;
+		PFN_vkCmdSetDescriptorBufferOffsetsEXT m_vkCmdSetDescriptorBufferOffsetsEXT = nullptr;
 
+		// Resources waiting for the fence of an empty submission issued after their last use
+		struct RetiredResources {
+			VkFence fence = VK_NULL_HANDLE;
+			VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+			std::vector<VkImageView> imageViews;
+			std::vector<VkFramebuffer> framebuffers;
+			std::vector<DepthBuffer> depthBuffers;
+			std::vector<Image> images;
+			std::vector<VkSemaphore> semaphores;
+
+			bool isEmpty() const {
+				return swapchain == VK_NULL_HANDLE && imageViews.empty() && framebuffers.empty() && depthBuffers.empty() && images.empty() && semaphores.empty();
+			}
+		};
+		RetiredResources m_openRetirement;
+		std::deque<RetiredResources> m_retiredResources;
+		uint64_t m_sealedRetirements = 0;	// Index of the open retirement
+		uint64_t m_collectedRetirements = 0;
+		MemoryAllocator m_allocator;
+		TraceRecorder* m_traceRecorder = nullptr;
+		// Roles may share a VkQueue (no separate families or too few queues), every queue operation goes through this lock
+		std::mutex m_queueMutex;
 
 		// Initialization helpers
 		bool hasRequiredLayers(const std::vector<const char*> requiredLayers);
@@ -141,12 +313,23 @@ namespace LibGFX {
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> deviceExtensions);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
+		// Pipeline cache helpers
+		VkResult createPipelineCache(const void* initialData, size_t initialDataSize, VkPipelineCache* pipelineCache);
+		bool isPipelineCacheCompatible(const std::vector<char>& data) const;
+		void recordPipelineCreation(double createMs, const VkPipelineCreationFeedbackEXT& feedback);
+
 		// Swapchain helpers
+		SwapchainInfo buildSwapChain(VkPresentModeKHR presentMode, uint32_t desiredImageCount, VkSwapchainKHR oldSwapchain);
+		void sealRetirement();
+		void destroyRetiredResources(RetiredResources& resources);
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 		VkExtent2D chooseSwapchainExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
 		// Image helpers
-		void transitionImageLayout(VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount = 1);
+		void transitionImageLayout(VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout srcLayout, VkImageLayout dstLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1);
+		void submitImmediate(VkQueue queue, VkCommandBuffer commandBuffer);
+		// Transfer work followed by graphics work, recordRelease runs on the graphics queue before the transfer (e.g. returning ownership)
+		void submitUpload(VkCommandPool graphicsCommandPool, const std::function<void(VkCommandBuffer)>& recordTransfer, const std::function<void(VkCommandBuffer)>& recordGraphics, const std::function<void(VkCommandBuffer)>& recordRelease = nullptr);
 		GLFWwindow* m_targetWindow;
 	};
 